@@ -0,0 +1,131 @@
+#include "bit_packing.h"
+
+#include <array>
+#include <utility>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+namespace {
+constexpr size_t LANE_COUNT = 4;
+constexpr size_t VALUES_PER_LANE = PACKED_BLOCK_SIZE / LANE_COUNT;
+
+#ifdef __SSE2__
+template<unsigned BitWidth>
+void UnpackLanes(const uint32_t *packed, uint32_t *values) {
+    const auto *source = reinterpret_cast<const __m128i *>(packed);
+    auto *target = reinterpret_cast<__m128i *>(values);
+    if constexpr (BitWidth == 0) {
+        for (size_t group = 0; group < VALUES_PER_LANE; ++group) {
+            _mm_storeu_si128(target + group, _mm_setzero_si128());
+        }
+    } else {
+        const __m128i mask = _mm_set1_epi32(BitWidth == 32 ? -1 : static_cast<int>((1u << BitWidth) - 1));
+        __m128i word = _mm_loadu_si128(source++);
+        unsigned shift = 0;
+        for (size_t group = 0; group < VALUES_PER_LANE; ++group) {
+            __m128i value = _mm_srl_epi32(word, _mm_cvtsi32_si128(static_cast<int>(shift)));
+            shift += BitWidth;
+            if (shift >= 32) {
+                shift -= 32;
+                // the last group ends exactly on a word boundary, so there is nothing more to load
+                if (group + 1 != VALUES_PER_LANE) {
+                    word = _mm_loadu_si128(source++);
+                    if (shift > 0) {
+                        value = _mm_or_si128(value, _mm_sll_epi32(
+                                word, _mm_cvtsi32_si128(static_cast<int>(BitWidth - shift))));
+                    }
+                }
+            }
+            _mm_storeu_si128(target + group, _mm_and_si128(value, mask));
+        }
+    }
+}
+#else
+template<unsigned BitWidth>
+void UnpackLanes(const uint32_t *packed, uint32_t *values) {
+    for (size_t lane = 0; lane < LANE_COUNT; ++lane) {
+        uint64_t buffer = 0;
+        unsigned filled = 0;
+        size_t word = 0;
+        for (size_t index = 0; index < VALUES_PER_LANE; ++index) {
+            if (filled < BitWidth) {
+                buffer |= static_cast<uint64_t>(packed[word++ * LANE_COUNT + lane]) << filled;
+                filled += 32;
+            }
+            values[index * LANE_COUNT + lane] = static_cast<uint32_t>(buffer & ((uint64_t{1} << BitWidth) - 1));
+            buffer >>= BitWidth;
+            filled -= BitWidth;
+        }
+    }
+}
+#endif
+
+using UnpackFunction = void (*)(const uint32_t *, uint32_t *);
+
+template<size_t... BitWidths>
+constexpr array<UnpackFunction, sizeof...(BitWidths)> MakeUnpackTable(index_sequence<BitWidths...>) {
+    return {&UnpackLanes<BitWidths>...};
+}
+
+constexpr auto UNPACK_TABLE = MakeUnpackTable(make_index_sequence<33>());
+}
+
+unsigned GetRequiredBitWidth(const uint32_t *values, size_t count) {
+    uint32_t accumulated = 0;
+    for (size_t i = 0; i < count; ++i) {
+        accumulated |= values[i];
+    }
+    unsigned bit_width = 0;
+    while (bit_width < 32 && (accumulated >> bit_width) != 0) {
+        ++bit_width;
+    }
+    return bit_width;
+}
+
+void PackBlock(const uint32_t *values, unsigned bit_width, uint32_t *packed) {
+    if (bit_width == 0) {
+        return;
+    }
+    for (size_t lane = 0; lane < LANE_COUNT; ++lane) {
+        uint64_t buffer = 0;
+        unsigned filled = 0;
+        size_t word = 0;
+        for (size_t index = 0; index < VALUES_PER_LANE; ++index) {
+            buffer |= static_cast<uint64_t>(values[index * LANE_COUNT + lane]) << filled;
+            filled += bit_width;
+            if (filled >= 32) {
+                packed[word++ * LANE_COUNT + lane] = static_cast<uint32_t>(buffer);
+                buffer >>= 32;
+                filled -= 32;
+            }
+        }
+    }
+}
+
+void UnpackBlock(const uint32_t *packed, unsigned bit_width, uint32_t *values) {
+    UNPACK_TABLE[bit_width](packed, values);
+}
+
+void DecodeDeltas(uint32_t base, uint32_t *values) {
+#ifdef __SSE2__
+    auto *target = reinterpret_cast<__m128i *>(values);
+    __m128i carry = _mm_set1_epi32(static_cast<int>(base));
+    for (size_t group = 0; group < VALUES_PER_LANE; ++group) {
+        __m128i sums = _mm_loadu_si128(target + group);
+        sums = _mm_add_epi32(sums, _mm_slli_si128(sums, 4));
+        sums = _mm_add_epi32(sums, _mm_slli_si128(sums, 8));
+        sums = _mm_add_epi32(sums, carry);
+        _mm_storeu_si128(target + group, sums);
+        carry = _mm_shuffle_epi32(sums, _MM_SHUFFLE(3, 3, 3, 3));
+    }
+#else
+    for (size_t i = 0; i < PACKED_BLOCK_SIZE; ++i) {
+        base += values[i];
+        values[i] = base;
+    }
+#endif
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Blocks of 128 unsigned values packed with a common bit width. Values are laid out
+// vertically across four 32-bit lanes (value i goes to lane i % 4), so one SSE2
+// shift/mask step unpacks four values at a time
+constexpr std::size_t PACKED_BLOCK_SIZE = 128;
+
+constexpr std::size_t GetPackedWordCount(unsigned bit_width) {
+    return bit_width * PACKED_BLOCK_SIZE / 32;
+}
+
+unsigned GetRequiredBitWidth(const uint32_t *values, std::size_t count);
+
+// values must hold PACKED_BLOCK_SIZE entries, each below 2^bit_width
+void PackBlock(const uint32_t *values, unsigned bit_width, uint32_t *packed);
+
+void UnpackBlock(const uint32_t *packed, unsigned bit_width, uint32_t *values);
+
+// Turns PACKED_BLOCK_SIZE gaps into running sums starting from base
+void DecodeDeltas(uint32_t base, uint32_t *values);
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "posting_list.h"
+
+// One bit per document ordinal
+class DocumentBitmap {
+public:
+    void Resize(std::size_t size) {
+        words_.resize((size + 63) / 64, 0);
+    }
+
+    void Set(DocumentOrdinal ordinal) {
+        words_[ordinal / 64] |= uint64_t{1} << (ordinal % 64);
+    }
+
+    void Reset(DocumentOrdinal ordinal) {
+        words_[ordinal / 64] &= ~(uint64_t{1} << (ordinal % 64));
+    }
+
+    bool Test(DocumentOrdinal ordinal) const {
+        return (words_[ordinal / 64] >> (ordinal % 64)) & 1;
+    }
+
+    // True until the first Resize or Fill; an empty bitmap stands for no documents at all
+    bool empty() const {
+        return words_.empty();
+    }
+
+    void Clear() {
+        words_.assign(words_.size(), 0);
+    }
+
+    // Rebuilds the bitmap from predicate(ordinal), 64 ordinals per word; the inner loop
+    // has no branches so it is vectorized for simple column predicates
+    template<typename Predicate>
+    void Fill(std::size_t size, Predicate predicate) {
+        words_.assign((size + 63) / 64, 0);
+        for (std::size_t base = 0; base < size; base += 64) {
+            const std::size_t count = size - base < 64 ? size - base : 64;
+            uint64_t word = 0;
+            for (std::size_t bit = 0; bit < count; ++bit) {
+                word |= uint64_t{predicate(static_cast<DocumentOrdinal>(base + bit))} << bit;
+            }
+            words_[base / 64] = word;
+        }
+    }
+
+private:
+    std::vector<uint64_t> words_;
+};
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstdint>
+
+// splitmix64 finalizer: spreads every input bit over the whole result
+inline uint64_t MixBits(uint64_t value) {
+    value ^= value >> 30;
+    value *= 0xbf58476d1ce4e5b9ULL;
+    value ^= value >> 27;
+    value *= 0x94d049bb133111ebULL;
+    return value ^ (value >> 31);
+}
@@ -0,0 +1,50 @@
+#include "impact_index.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+ImpactIndex::ImpactIndex(const vector<PostingList> &term_postings, const vector<double> &inverse_document_freqs)
+        : terms_(term_postings.size()) {
+    double max_score = 0.0;
+    for (size_t term_id = 0; term_id < term_postings.size(); ++term_id) {
+        max_score = max(max_score, term_postings[term_id].GetMaxTermFreq() * inverse_document_freqs[term_id]);
+    }
+    if (max_score > 0.0) {
+        impact_step_ = max_score / MAX_IMPACT;
+    }
+
+    vector<pair<uint16_t, DocumentOrdinal>> impacts;
+    for (size_t term_id = 0; term_id < term_postings.size(); ++term_id) {
+        impacts.clear();
+        term_postings[term_id].ForEach([&](DocumentOrdinal ordinal, double term_freq) {
+            const double score = term_freq * inverse_document_freqs[term_id];
+            const double impact = min(ceil(score / impact_step_), static_cast<double>(MAX_IMPACT));
+            impacts.emplace_back(static_cast<uint16_t>(impact), ordinal);
+        });
+        // postings come in ordinal order, so a stable sort keeps each segment ascending
+        stable_sort(impacts.begin(), impacts.end(), [](const auto &lhs, const auto &rhs) {
+            return lhs.first > rhs.first;
+        });
+
+        auto &term = terms_[term_id];
+        term.ordinals.reserve(impacts.size());
+        for (const auto &[impact, ordinal]: impacts) {
+            const auto position = static_cast<uint32_t>(term.ordinals.size());
+            if (term.segments.empty() || term.segments.back().impact != impact) {
+                term.segments.push_back({impact, position, position});
+            }
+            term.ordinals.push_back(ordinal);
+            ++term.segments.back().end;
+        }
+    }
+}
+
+size_t ImpactIndex::GetMemoryUsage() const {
+    size_t bytes = sizeof(*this) + terms_.capacity() * sizeof(TermImpacts);
+    for (const auto &term: terms_) {
+        bytes += term.segments.capacity() * sizeof(ImpactSegment) + term.ordinals.capacity() * sizeof(DocumentOrdinal);
+    }
+    return bytes;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "posting_list.h"
+#include "term_dictionary.h"
+
+// Postings with the same quantized impact, a run inside the term's ordinals
+struct ImpactSegment {
+    uint16_t impact;
+    uint32_t begin;
+    uint32_t end;
+};
+
+// Read-only copy of the inverted index where every posting carries its idf * tf contribution
+// quantized to 16 bits, and each term's postings are ordered by descending impact. Impacts are
+// rounded up, so impact * GetImpactStep() bounds the real contribution from above
+class ImpactIndex {
+public:
+    static constexpr uint16_t MAX_IMPACT = UINT16_MAX;
+
+    // inverse_document_freqs is indexed by TermId, like term_postings
+    ImpactIndex(const std::vector<PostingList> &term_postings, const std::vector<double> &inverse_document_freqs);
+
+    double GetImpactStep() const {
+        return impact_step_;
+    }
+
+    // Highest impact first; within a segment the ordinals ascend
+    const std::vector<ImpactSegment> &GetSegments(TermId term_id) const {
+        return terms_[term_id].segments;
+    }
+
+    const DocumentOrdinal *GetOrdinals(TermId term_id) const {
+        return terms_[term_id].ordinals.data();
+    }
+
+    std::size_t GetMemoryUsage() const;
+
+private:
+    struct TermImpacts {
+        std::vector<ImpactSegment> segments;
+        std::vector<DocumentOrdinal> ordinals;
+    };
+
+    double impact_step_ = 1.0;
+    std::vector<TermImpacts> terms_;
+};
@@ -68,6 +68,10 @@ int main() {
     for (size_t i = 0; i < documents.size(); ++i) {
         search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
     }
+    const auto index_stats = search_server.GetIndexStats();
+    cout << "postings: " << index_stats.posting_count << ", bytes per posting: "
+         << static_cast<double>(index_stats.posting_bytes) / index_stats.posting_count << endl;
+    cout << "text bytes: " << index_stats.text_bytes << ", live: " << index_stats.live_text_bytes << endl;
     const auto queries = GenerateQueries(generator, dictionary, 100, 70);
     TEST(seq);
     TEST(par);
@@ -0,0 +1,419 @@
+#include "posting_list.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "document_bitmap.h"
+
+using namespace std;
+
+#ifdef SEARCH_SERVER_COMPRESSED_POSTINGS
+
+void PostingList::Add(DocumentOrdinal ordinal, uint32_t term_count, uint32_t document_length) {
+    if (!empty() && ordinal <= GetBlockLastOrdinal(GetBlockCount() - 1)) {
+        throw invalid_argument("Postings must be added in ordinal order");
+    }
+    tail_.ordinals.push_back(ordinal);
+    tail_.term_counts.push_back(term_count);
+    tail_.document_lengths.push_back(document_length);
+    ++size_;
+    const double term_freq = static_cast<double>(term_count) / document_length;
+    tail_max_term_freq_ = max(tail_max_term_freq_, term_freq);
+    max_term_freq_ = max(max_term_freq_, term_freq);
+    if (tail_.ordinals.size() == BLOCK_SIZE) {
+        blocks_.push_back(Pack(tail_));
+        tail_ = RawBlock{};
+        tail_max_term_freq_ = 0.0;
+    }
+}
+
+bool PostingList::Remove(DocumentOrdinal ordinal) {
+    const auto in_tail = lower_bound(tail_.ordinals.begin(), tail_.ordinals.end(), ordinal);
+    if (in_tail != tail_.ordinals.end() && *in_tail == ordinal) {
+        const auto index = in_tail - tail_.ordinals.begin();
+        tail_.ordinals.erase(in_tail);
+        tail_.term_counts.erase(tail_.term_counts.begin() + index);
+        tail_.document_lengths.erase(tail_.document_lengths.begin() + index);
+        --size_;
+        tail_max_term_freq_ = 0.0;
+        for (size_t i = 0; i < tail_.ordinals.size(); ++i) {
+            tail_max_term_freq_ = max(tail_max_term_freq_,
+                                      static_cast<double>(tail_.term_counts[i]) / tail_.document_lengths[i]);
+        }
+        UpdateMaxTermFreq();
+        return true;
+    }
+
+    const auto block = partition_point(blocks_.begin(), blocks_.end(), [ordinal](const PackedBlock &packed) {
+        return packed.last_ordinal < ordinal;
+    });
+    if (block == blocks_.end() || block->first_ordinal > ordinal) {
+        return false;
+    }
+    RawBlock raw = Unpack(*block);
+    const auto position = lower_bound(raw.ordinals.begin(), raw.ordinals.end(), ordinal);
+    if (position == raw.ordinals.end() || *position != ordinal) {
+        return false;
+    }
+    const auto index = position - raw.ordinals.begin();
+    raw.ordinals.erase(position);
+    raw.term_counts.erase(raw.term_counts.begin() + index);
+    raw.document_lengths.erase(raw.document_lengths.begin() + index);
+    if (raw.ordinals.empty()) {
+        blocks_.erase(block);
+    } else {
+        *block = Pack(raw);
+    }
+    --size_;
+    UpdateMaxTermFreq();
+    return true;
+}
+
+size_t PostingList::Remove(const DocumentBitmap &removed) {
+    const size_t old_size = size_;
+    const auto remove_from = [&removed](RawBlock &raw) {
+        size_t kept = 0;
+        for (size_t i = 0; i < raw.ordinals.size(); ++i) {
+            if (!removed.Test(raw.ordinals[i])) {
+                raw.ordinals[kept] = raw.ordinals[i];
+                raw.term_counts[kept] = raw.term_counts[i];
+                raw.document_lengths[kept] = raw.document_lengths[i];
+                ++kept;
+            }
+        }
+        const size_t count = raw.ordinals.size() - kept;
+        raw.ordinals.resize(kept);
+        raw.term_counts.resize(kept);
+        raw.document_lengths.resize(kept);
+        return count;
+    };
+
+    size_t kept_blocks = 0;
+    for (size_t block = 0; block < blocks_.size(); ++block) {
+        uint32_t ordinals[BLOCK_SIZE];
+        UnpackBlock(blocks_[block].data.data(), blocks_[block].gap_bits, ordinals);
+        DecodeDeltas(blocks_[block].first_ordinal, ordinals);
+        if (any_of(ordinals, ordinals + blocks_[block].size, [&removed](DocumentOrdinal ordinal) {
+            return removed.Test(ordinal);
+        })) {
+            RawBlock raw = Unpack(blocks_[block]);
+            size_ -= remove_from(raw);
+            if (raw.ordinals.empty()) {
+                continue;
+            }
+            blocks_[block] = Pack(raw);
+        }
+        if (kept_blocks != block) {
+            blocks_[kept_blocks] = move(blocks_[block]);
+        }
+        ++kept_blocks;
+    }
+    blocks_.resize(kept_blocks);
+
+    const size_t tail_removed = remove_from(tail_);
+    if (tail_removed > 0) {
+        size_ -= tail_removed;
+        tail_max_term_freq_ = 0.0;
+        for (size_t i = 0; i < tail_.ordinals.size(); ++i) {
+            tail_max_term_freq_ = max(tail_max_term_freq_,
+                                      static_cast<double>(tail_.term_counts[i]) / tail_.document_lengths[i]);
+        }
+    }
+    if (size_ != old_size) {
+        UpdateMaxTermFreq();
+    }
+    return old_size - size_;
+}
+
+void PostingList::Remap(const vector<DocumentOrdinal> &new_ordinals) {
+    for (auto &block: blocks_) {
+        RawBlock raw = Unpack(block);
+        for (auto &ordinal: raw.ordinals) {
+            ordinal = new_ordinals[ordinal];
+        }
+        block = Pack(raw);
+    }
+    for (auto &ordinal: tail_.ordinals) {
+        ordinal = new_ordinals[ordinal];
+    }
+}
+
+size_t PostingList::GetBlockCount() const {
+    return blocks_.size() + (tail_.ordinals.empty() ? 0 : 1);
+}
+
+DocumentOrdinal PostingList::GetBlockLastOrdinal(size_t block) const {
+    return block < blocks_.size() ? blocks_[block].last_ordinal : tail_.ordinals.back();
+}
+
+double PostingList::GetBlockMaxTermFreq(size_t block) const {
+    return block < blocks_.size() ? blocks_[block].max_term_freq : tail_max_term_freq_;
+}
+
+PostingBlock PostingList::GetBlock(size_t block, PostingBuffer &buffer) const {
+    if (block == blocks_.size()) {
+        for (size_t i = 0; i < tail_.ordinals.size(); ++i) {
+            buffer.ordinals[i] = tail_.ordinals[i];
+            buffer.term_freqs[i] = static_cast<double>(tail_.term_counts[i]) / tail_.document_lengths[i];
+        }
+        return {buffer.ordinals, buffer.term_freqs, tail_.ordinals.size()};
+    }
+    const auto &packed = blocks_[block];
+    uint32_t term_counts[BLOCK_SIZE];
+    uint32_t document_lengths[BLOCK_SIZE];
+    UnpackColumns(packed, buffer.ordinals, term_counts, document_lengths);
+    for (size_t i = 0; i < packed.size; ++i) {
+        buffer.term_freqs[i] = static_cast<double>(term_counts[i]) / document_lengths[i];
+    }
+    return {buffer.ordinals, buffer.term_freqs, packed.size};
+}
+
+size_t PostingList::GetMemoryUsage() const {
+    size_t bytes = sizeof(*this) + blocks_.capacity() * sizeof(PackedBlock);
+    for (const auto &block: blocks_) {
+        bytes += block.data.capacity() * sizeof(uint32_t);
+    }
+    bytes += tail_.ordinals.capacity() * sizeof(DocumentOrdinal);
+    bytes += (tail_.term_counts.capacity() + tail_.document_lengths.capacity()) * sizeof(uint32_t);
+    return bytes;
+}
+
+PostingList::PackedBlock PostingList::Pack(const RawBlock &raw) {
+    const size_t size = raw.ordinals.size();
+    uint32_t gaps[BLOCK_SIZE] = {};
+    uint32_t term_counts[BLOCK_SIZE] = {};
+    uint32_t document_lengths[BLOCK_SIZE] = {};
+    double max_term_freq = 0.0;
+    for (size_t i = 0; i < size; ++i) {
+        gaps[i] = i == 0 ? 0 : raw.ordinals[i] - raw.ordinals[i - 1];
+        term_counts[i] = raw.term_counts[i];
+        document_lengths[i] = raw.document_lengths[i];
+        max_term_freq = max(max_term_freq, static_cast<double>(term_counts[i]) / document_lengths[i]);
+    }
+
+    PackedBlock packed;
+    packed.max_term_freq = max_term_freq;
+    packed.first_ordinal = raw.ordinals.front();
+    packed.last_ordinal = raw.ordinals.back();
+    packed.size = static_cast<uint8_t>(size);
+    packed.gap_bits = static_cast<uint8_t>(GetRequiredBitWidth(gaps, size));
+    packed.count_bits = static_cast<uint8_t>(GetRequiredBitWidth(term_counts, size));
+    packed.length_bits = static_cast<uint8_t>(GetRequiredBitWidth(document_lengths, size));
+
+    const size_t gap_words = GetPackedWordCount(packed.gap_bits);
+    const size_t count_words = GetPackedWordCount(packed.count_bits);
+    packed.data.resize(gap_words + count_words + GetPackedWordCount(packed.length_bits));
+    PackBlock(gaps, packed.gap_bits, packed.data.data());
+    PackBlock(term_counts, packed.count_bits, packed.data.data() + gap_words);
+    PackBlock(document_lengths, packed.length_bits, packed.data.data() + gap_words + count_words);
+    return packed;
+}
+
+PostingList::RawBlock PostingList::Unpack(const PackedBlock &packed) {
+    uint32_t ordinals[BLOCK_SIZE];
+    uint32_t term_counts[BLOCK_SIZE];
+    uint32_t document_lengths[BLOCK_SIZE];
+    UnpackColumns(packed, ordinals, term_counts, document_lengths);
+    return {{ordinals, ordinals + packed.size},
+            {term_counts, term_counts + packed.size},
+            {document_lengths, document_lengths + packed.size}};
+}
+
+void PostingList::UpdateMaxTermFreq() {
+    max_term_freq_ = tail_max_term_freq_;
+    for (const auto &block: blocks_) {
+        max_term_freq_ = max(max_term_freq_, block.max_term_freq);
+    }
+}
+
+void PostingList::UnpackColumns(const PackedBlock &packed, uint32_t *ordinals, uint32_t *term_counts,
+                                uint32_t *document_lengths) {
+    const uint32_t *data = packed.data.data();
+    UnpackBlock(data, packed.gap_bits, ordinals);
+    DecodeDeltas(packed.first_ordinal, ordinals);
+    data += GetPackedWordCount(packed.gap_bits);
+    UnpackBlock(data, packed.count_bits, term_counts);
+    data += GetPackedWordCount(packed.count_bits);
+    UnpackBlock(data, packed.length_bits, document_lengths);
+}
+
+#else
+
+void PostingList::Add(DocumentOrdinal ordinal, uint32_t term_count, uint32_t document_length) {
+    if (!ordinals_.empty() && ordinal <= ordinals_.back()) {
+        throw invalid_argument("Postings must be added in ordinal order");
+    }
+    const double term_freq = static_cast<double>(term_count) / document_length;
+    ordinals_.push_back(ordinal);
+    term_freqs_.push_back(term_freq);
+    if (size_++ % BLOCK_SIZE == 0) {
+        block_max_term_freqs_.push_back(term_freq);
+    } else {
+        block_max_term_freqs_.back() = max(block_max_term_freqs_.back(), term_freq);
+    }
+    max_term_freq_ = max(max_term_freq_, term_freq);
+}
+
+bool PostingList::Remove(DocumentOrdinal ordinal) {
+    const auto it = lower_bound(ordinals_.begin(), ordinals_.end(), ordinal);
+    if (it == ordinals_.end() || *it != ordinal) {
+        return false;
+    }
+    const size_t index = it - ordinals_.begin();
+    term_freqs_.erase(term_freqs_.begin() + index);
+    ordinals_.erase(it);
+    --size_;
+    // every later posting moves one place back, so the following blocks change too
+    UpdateBlockMaxima(index / BLOCK_SIZE);
+    UpdateMaxTermFreq();
+    return true;
+}
+
+size_t PostingList::Remove(const DocumentBitmap &removed) {
+    const auto first_removed = find_if(ordinals_.begin(), ordinals_.end(), [&removed](DocumentOrdinal ordinal) {
+        return removed.Test(ordinal);
+    });
+    if (first_removed == ordinals_.end()) {
+        return 0;
+    }
+    const size_t first = first_removed - ordinals_.begin();
+    size_t kept = first;
+    for (size_t i = first; i < size_; ++i) {
+        if (!removed.Test(ordinals_[i])) {
+            ordinals_[kept] = ordinals_[i];
+            term_freqs_[kept] = term_freqs_[i];
+            ++kept;
+        }
+    }
+    const size_t count = size_ - kept;
+    ordinals_.resize(kept);
+    term_freqs_.resize(kept);
+    size_ = kept;
+    // the postings after the first removed one have moved, so every block from its block on changes
+    UpdateBlockMaxima(first / BLOCK_SIZE);
+    UpdateMaxTermFreq();
+    return count;
+}
+
+void PostingList::Remap(const vector<DocumentOrdinal> &new_ordinals) {
+    for (auto &ordinal: ordinals_) {
+        ordinal = new_ordinals[ordinal];
+    }
+}
+
+size_t PostingList::GetBlockCount() const {
+    return (size_ + BLOCK_SIZE - 1) / BLOCK_SIZE;
+}
+
+DocumentOrdinal PostingList::GetBlockLastOrdinal(size_t block) const {
+    return ordinals_[min((block + 1) * BLOCK_SIZE, size_) - 1];
+}
+
+double PostingList::GetBlockMaxTermFreq(size_t block) const {
+    return block_max_term_freqs_[block];
+}
+
+PostingBlock PostingList::GetBlock(size_t block, PostingBuffer &) const {
+    return GetBlock(block);
+}
+
+PostingBlock PostingList::GetBlock(size_t block) const {
+    const size_t begin = block * BLOCK_SIZE;
+    return {ordinals_.data() + begin, term_freqs_.data() + begin, min(BLOCK_SIZE, size_ - begin)};
+}
+
+size_t PostingList::GetMemoryUsage() const {
+    return sizeof(*this) + ordinals_.capacity() * sizeof(DocumentOrdinal)
+           + (term_freqs_.capacity() + block_max_term_freqs_.capacity()) * sizeof(double);
+}
+
+void PostingList::UpdateBlockMaxima(size_t first_block) {
+    block_max_term_freqs_.resize(GetBlockCount());
+    for (size_t block = first_block; block < block_max_term_freqs_.size(); ++block) {
+        const auto begin = term_freqs_.begin() + block * BLOCK_SIZE;
+        block_max_term_freqs_[block] = *max_element(begin, begin + min(BLOCK_SIZE, size_ - block * BLOCK_SIZE));
+    }
+}
+
+void PostingList::UpdateMaxTermFreq() {
+    max_term_freq_ = block_max_term_freqs_.empty()
+                     ? 0.0 : *max_element(block_max_term_freqs_.begin(), block_max_term_freqs_.end());
+}
+
+#endif
+
+PostingCursor::PostingCursor(const PostingList &postings)
+        : postings_(&postings), block_count_(postings.GetBlockCount()) {
+    if (!AtEnd()) {
+        LoadBlock(0);
+    }
+}
+
+void PostingCursor::Next() {
+    if (++position_ == current_.size) {
+        ++block_;
+        if (!AtEnd()) {
+            LoadBlock(block_);
+        }
+    }
+}
+
+void PostingCursor::SkipTo(DocumentOrdinal target) {
+    if (AtEnd() || GetOrdinal() >= target) {
+        return;
+    }
+    if (postings_->GetBlockLastOrdinal(block_) < target) {
+        block_ = FindBlock(block_ + 1, target);
+        if (AtEnd()) {
+            return;
+        }
+        LoadBlock(block_);
+    }
+    position_ = lower_bound(current_.ordinals + position_, current_.ordinals + current_.size, target)
+                - current_.ordinals;
+}
+
+double PostingCursor::GetMaxTermFreq(DocumentOrdinal first, DocumentOrdinal last) {
+    bound_block_ = FindBlock(max(bound_block_, block_), first);
+    double max_term_freq = 0.0;
+    for (size_t block = bound_block_; block < block_count_; ++block) {
+        max_term_freq = max(max_term_freq, postings_->GetBlockMaxTermFreq(block));
+        if (postings_->GetBlockLastOrdinal(block) >= last) {
+            break;
+        }
+    }
+    return max_term_freq;
+}
+
+size_t PostingCursor::FindBlock(size_t from, DocumentOrdinal target) const {
+    if (from >= block_count_ || postings_->GetBlockLastOrdinal(from) >= target) {
+        return min(from, block_count_);
+    }
+    // gallop over the block headers, then binary search the last step
+    size_t low = from + 1;
+    size_t step = 1;
+    while (low + step < block_count_ && postings_->GetBlockLastOrdinal(low + step - 1) < target) {
+        low += step;
+        step *= 2;
+    }
+    size_t high = min(low + step, block_count_);
+    while (low < high) {
+        const size_t middle = low + (high - low) / 2;
+        if (postings_->GetBlockLastOrdinal(middle) < target) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+void PostingCursor::LoadBlock(size_t block) {
+    block_ = block;
+    position_ = 0;
+#ifdef SEARCH_SERVER_COMPRESSED_POSTINGS
+    current_ = postings_->GetBlock(block, *buffer_);
+#else
+    current_ = postings_->GetBlock(block);
+#endif
+}
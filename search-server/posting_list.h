@@ -0,0 +1,175 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "bit_packing.h"
+
+// Dense internal document number, assigned in insertion order
+using DocumentOrdinal = uint32_t;
+
+class DocumentBitmap;
+
+// Decoded postings of one block; the pointers stay valid until the list is modified
+// or the buffer they were decoded into is reused
+struct PostingBlock {
+    const DocumentOrdinal *ordinals;
+    const double *term_freqs;
+    std::size_t size;
+};
+
+struct PostingBuffer {
+    DocumentOrdinal ordinals[PACKED_BLOCK_SIZE];
+    double term_freqs[PACKED_BLOCK_SIZE];
+};
+
+// Postings of one term sorted by document ordinal, split into blocks of BLOCK_SIZE.
+// With SEARCH_SERVER_COMPRESSED_POSTINGS every full block is stored as bit-packed
+// ordinal gaps, term counts and document lengths; otherwise postings are kept as
+// plain ordinal and term frequency arrays
+class PostingList {
+public:
+    static constexpr std::size_t BLOCK_SIZE = PACKED_BLOCK_SIZE;
+
+    // Ordinals must be added in increasing order
+    void Add(DocumentOrdinal ordinal, uint32_t term_count, uint32_t document_length);
+
+    bool Remove(DocumentOrdinal ordinal);
+
+    // Drops the postings of every ordinal set in removed in one pass; returns how many there were
+    std::size_t Remove(const DocumentBitmap &removed);
+
+    // Renumbers every posting; new_ordinals must be increasing over the ordinals in use
+    void Remap(const std::vector<DocumentOrdinal> &new_ordinals);
+
+    std::size_t size() const {
+        return size_;
+    }
+
+    bool empty() const {
+        return size_ == 0;
+    }
+
+    std::size_t GetBlockCount() const;
+
+    DocumentOrdinal GetBlockLastOrdinal(std::size_t block) const;
+
+    double GetBlockMaxTermFreq(std::size_t block) const;
+
+    double GetMaxTermFreq() const {
+        return max_term_freq_;
+    }
+
+    PostingBlock GetBlock(std::size_t block, PostingBuffer &buffer) const;
+
+#ifndef SEARCH_SERVER_COMPRESSED_POSTINGS
+    // Raw blocks are read in place, without a buffer
+    PostingBlock GetBlock(std::size_t block) const;
+#endif
+
+    template<typename Function>
+    void ForEach(Function function) const;
+
+    std::size_t GetMemoryUsage() const;
+
+private:
+    std::size_t size_ = 0;
+    double max_term_freq_ = 0.0;
+
+#ifdef SEARCH_SERVER_COMPRESSED_POSTINGS
+    struct PackedBlock {
+        DocumentOrdinal first_ordinal;
+        DocumentOrdinal last_ordinal;
+        uint8_t size;
+        uint8_t gap_bits;
+        uint8_t count_bits;
+        uint8_t length_bits;
+        double max_term_freq;
+        std::vector<uint32_t> data;
+    };
+
+    // Unpacked form of one block, used while encoding and editing
+    struct RawBlock {
+        std::vector<DocumentOrdinal> ordinals;
+        std::vector<uint32_t> term_counts;
+        std::vector<uint32_t> document_lengths;
+    };
+
+    std::vector<PackedBlock> blocks_;
+    // The newest postings, fewer than BLOCK_SIZE, not packed yet
+    RawBlock tail_;
+    double tail_max_term_freq_ = 0.0;
+
+    static PackedBlock Pack(const RawBlock &raw);
+
+    static RawBlock Unpack(const PackedBlock &packed);
+
+    static void UnpackColumns(const PackedBlock &packed, uint32_t *ordinals, uint32_t *term_counts,
+                              uint32_t *document_lengths);
+#else
+    std::vector<DocumentOrdinal> ordinals_;
+    std::vector<double> term_freqs_;
+    std::vector<double> block_max_term_freqs_;
+
+    void UpdateBlockMaxima(std::size_t first_block);
+#endif
+
+    void UpdateMaxTermFreq();
+};
+
+// Forward-only reader over a PostingList that decodes one block at a time
+class PostingCursor {
+public:
+    explicit PostingCursor(const PostingList &postings);
+
+    bool AtEnd() const {
+        return block_ == block_count_;
+    }
+
+    DocumentOrdinal GetOrdinal() const {
+        return current_.ordinals[position_];
+    }
+
+    double GetTermFreq() const {
+        return current_.term_freqs[position_];
+    }
+
+    void Next();
+
+    // Moves to the first posting with ordinal >= target; blocks ending before target are not decoded
+    void SkipTo(DocumentOrdinal target);
+
+    // Bound on the term freqs of the postings in [first, last], read from the block headers without
+    // decoding or moving the cursor. Ranges must not move backwards between calls
+    double GetMaxTermFreq(DocumentOrdinal first, DocumentOrdinal last);
+
+private:
+    const PostingList *postings_;
+    std::size_t block_count_;
+    std::size_t block_ = 0;
+    std::size_t position_ = 0;
+    std::size_t bound_block_ = 0;
+    PostingBlock current_{};
+#ifdef SEARCH_SERVER_COMPRESSED_POSTINGS
+    // Blocks are decoded into a buffer of the cursor's own, which stays put when the cursor is moved
+    std::unique_ptr<PostingBuffer> buffer_ = std::make_unique<PostingBuffer>();
+#endif
+
+    void LoadBlock(std::size_t block);
+
+    // First block at or after `from` whose last ordinal is >= target
+    std::size_t FindBlock(std::size_t from, DocumentOrdinal target) const;
+};
+
+template<typename Function>
+void PostingList::ForEach(Function function) const {
+    PostingBuffer buffer;
+    for (std::size_t block = 0; block < GetBlockCount(); ++block) {
+        const PostingBlock postings = GetBlock(block, buffer);
+        for (std::size_t i = 0; i < postings.size; ++i) {
+            function(postings.ordinals[i], postings.term_freqs[i]);
+        }
+    }
+}
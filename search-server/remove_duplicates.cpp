@@ -1,22 +1,37 @@
-#include "remove_duplicates.h"
-
-using namespace std;
-void RemoveDuplicates(SearchServer& search_server) {
-    vector<int> to_delete;
-    set<set<string>> collections;
-    for (int id: search_server) {
-        set<string> coll;
-        for (auto& [w, _] : search_server.GetWordFrequencies(id)) {
-            coll.insert(w);
-        }
-        if (collections.count(coll) > 0) {
-            to_delete.push_back(id);
-        } else {
-            collections.insert(coll);
-        }
-    }
-    for (int id : to_delete) {
-        search_server.RemoveDocument(id);
-        cout << "Found duplicate document id " << id << endl;
-    }
-}
+#include "remove_duplicates.h"
+
+#include <unordered_map>
+
+using namespace std;
+void RemoveDuplicates(SearchServer& search_server) {
+    const vector<int> document_ids(search_server.begin(), search_server.end());
+    vector<TermSetFingerprint> fingerprints(document_ids.size());
+    transform(execution::par, document_ids.begin(), document_ids.end(), fingerprints.begin(),
+              [&search_server](int id) { return search_server.GetWordSetFingerprint(id); });
+
+    // the ids ascend, so the first document with a set of words is the one kept
+    unordered_map<TermSetFingerprint, int, TermSetFingerprintHasher> originals;
+    originals.reserve(document_ids.size());
+    // Documents whose fingerprint matched an original with other words; practically never filled
+    vector<pair<TermSetFingerprint, int>> colliding;
+    vector<int> to_delete;
+    for (size_t i = 0; i < document_ids.size(); ++i) {
+        const int id = document_ids[i];
+        const auto [original, inserted] = originals.emplace(fingerprints[i], id);
+        if (inserted) {
+            continue;
+        }
+        if (search_server.HaveSameWords(original->second, id)
+            || any_of(colliding.begin(), colliding.end(), [&](const pair<TermSetFingerprint, int> &other) {
+                return other.first == fingerprints[i] && search_server.HaveSameWords(other.second, id);
+            })) {
+            to_delete.push_back(id);
+        } else {
+            colliding.emplace_back(fingerprints[i], id);
+        }
+    }
+    for (int id : to_delete) {
+        cout << "Found duplicate document id " << id << endl;
+    }
+    search_server.RemoveDocuments(to_delete);
+}
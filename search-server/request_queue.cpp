@@ -2,14 +2,31 @@
 
 RequestQueue::RequestQueue(const SearchServer& search_server) :my_search_server(search_server) {}
 std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query, DocumentStatus status) {
-  return AddFindRequest(
-      raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
-        return document_status == status;
-      });
+  return AddResult(my_search_server.FindTopDocuments(raw_query, status));
 }
 std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query)  {
   return AddFindRequest(raw_query, DocumentStatus::ACTUAL);
 }
+std::vector<Document> RequestQueue::AddResult(std::vector<Document> res) {
+  if (!res.empty() && requests_.size() == min_in_day_ ) {
+    --not_found_query;
+    requests_.pop_front();
+    requests_.emplace_back(true);
+    return res;
+  }
+  if (requests_.size() == min_in_day_) {
+    requests_.pop_front();
+    requests_.emplace_back(true);
+    return res;
+  }
+  if (res.empty()) {
+    requests_.emplace_back(true);
+    ++not_found_query;
+    return res;
+  }
+  requests_.emplace_back(true);
+  return res;
+}
 int RequestQueue::GetNoResultRequests() const {
   return not_found_query;
 }
@@ -14,6 +14,7 @@ class RequestQueue {
     QueryResult(bool output): res_(output) {};
     bool res_;
   };
+  std::vector<Document> AddResult(std::vector<Document> res);
   std::deque<QueryResult> requests_;
   const static int min_in_day_ = 1440;
   int not_found_query = 0;
@@ -23,23 +24,5 @@ class RequestQueue {
 
 template<typename DocumentPredicate>
 std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query, DocumentPredicate document_predicate) {
-  auto res = my_search_server.FindTopDocuments(raw_query,document_predicate);
-  if (!res.empty() && requests_.size() == min_in_day_ ) {
-    --not_found_query;
-    requests_.pop_front();
-    requests_.emplace_back(true);
-    return res;
-  }
-  if (requests_.size() == min_in_day_) {
-    requests_.pop_front();
-    requests_.emplace_back(true);
-    return res;
-  }
-  if (res.empty()) {
-    requests_.emplace_back(true);
-    ++not_found_query;
-    return res;
-  }
-  requests_.emplace_back(true);
-  return res;
+  return AddResult(my_search_server.FindTopDocuments(raw_query,document_predicate));
 }
@@ -0,0 +1,115 @@
+#include "result_cache.h"
+
+using namespace std;
+
+namespace {
+
+void HashCombine(size_t &seed, size_t value) {
+    seed ^= value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2);
+}
+
+}
+
+bool ResultCacheKey::operator==(const ResultCacheKey &other) const {
+    return status == other.status && k == other.k && offset == other.offset
+           && plus_terms == other.plus_terms && minus_terms == other.minus_terms;
+}
+
+size_t ResultCache::KeyHash::operator()(const ResultCacheKey &key) const {
+    size_t seed = key.plus_terms.size();
+    for (const TermId term_id: key.plus_terms) {
+        HashCombine(seed, term_id);
+    }
+    HashCombine(seed, key.minus_terms.size());
+    for (const TermId term_id: key.minus_terms) {
+        HashCombine(seed, term_id);
+    }
+    HashCombine(seed, static_cast<size_t>(key.status));
+    HashCombine(seed, key.k);
+    HashCombine(seed, key.offset);
+    return seed;
+}
+
+ResultCache::ResultCache(size_t capacity)
+        : capacity_(capacity), shard_capacity_((capacity + SHARD_COUNT - 1) / SHARD_COUNT) {
+}
+
+ResultCache::ResultCache(const ResultCache &other) : ResultCache(other.capacity_) {
+}
+
+ResultCache &ResultCache::operator=(const ResultCache &other) {
+    if (this != &other) {
+        SetCapacity(other.capacity_);
+    }
+    return *this;
+}
+
+ResultCache::Shard &ResultCache::GetShard(size_t hash) {
+    // the low bits pick the bucket inside the shard, so the shard is taken from the high ones
+    return shards_[(hash >> (sizeof(size_t) * 8 - 4)) % SHARD_COUNT];
+}
+
+optional<vector<Document>> ResultCache::Find(const ResultCacheKey &key, uint64_t generation) {
+    if (capacity_ == 0) {
+        return nullopt;
+    }
+    const size_t hash = KeyHash{}(key);
+    Shard &shard = GetShard(hash);
+    {
+        lock_guard guard(shard.mutex);
+        const auto position = shard.positions.find(key);
+        if (position != shard.positions.end()) {
+            const auto entry = position->second;
+            if (entry->generation == generation) {
+                shard.entries.splice(shard.entries.begin(), shard.entries, entry);
+                hits_.fetch_add(1, memory_order_relaxed);
+                return entry->documents;
+            }
+            shard.positions.erase(position);
+            shard.entries.erase(entry);
+        }
+    }
+    misses_.fetch_add(1, memory_order_relaxed);
+    return nullopt;
+}
+
+void ResultCache::Insert(ResultCacheKey key, uint64_t generation, vector<Document> documents) {
+    if (capacity_ == 0) {
+        return;
+    }
+    const size_t hash = KeyHash{}(key);
+    Shard &shard = GetShard(hash);
+    lock_guard guard(shard.mutex);
+    const auto position = shard.positions.find(key);
+    if (position != shard.positions.end()) {
+        // another thread computed the same query meanwhile
+        position->second->generation = generation;
+        position->second->documents = move(documents);
+        shard.entries.splice(shard.entries.begin(), shard.entries, position->second);
+        return;
+    }
+    if (shard.entries.size() >= shard_capacity_) {
+        shard.positions.erase(shard.entries.back().key);
+        shard.entries.pop_back();
+    }
+    shard.entries.push_front(Entry{key, generation, move(documents)});
+    shard.positions.emplace(move(key), shard.entries.begin());
+}
+
+void ResultCache::SetCapacity(size_t capacity) {
+    for (auto &shard: shards_) {
+        lock_guard guard(shard.mutex);
+        shard.positions.clear();
+        shard.entries.clear();
+    }
+    capacity_ = capacity;
+    shard_capacity_ = (capacity + SHARD_COUNT - 1) / SHARD_COUNT;
+}
+
+size_t ResultCache::GetCapacity() const {
+    return capacity_;
+}
+
+ResultCacheStats ResultCache::GetStats() const {
+    return {hits_.load(memory_order_relaxed), misses_.load(memory_order_relaxed)};
+}
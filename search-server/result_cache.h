@@ -0,0 +1,83 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include "document.h"
+#include "term_dictionary.h"
+
+// A parsed query: sorted, deduplicated term ids, so word order and repeats don't matter
+struct ResultCacheKey {
+    std::vector<TermId> plus_terms;
+    std::vector<TermId> minus_terms;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::size_t k = 0;
+    std::size_t offset = 0;
+
+    bool operator==(const ResultCacheKey &other) const;
+};
+
+struct ResultCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+};
+
+// Results of recent queries, least recently used evicted first. Keys are spread over shards
+// with a lock each, so concurrent lookups rarely wait on each other. An entry remembers the
+// index generation it was computed at and is dropped when looked up at any other
+class ResultCache {
+public:
+    // Off by default
+    explicit ResultCache(std::size_t capacity = 0);
+
+    // The entries belong to the index they were computed on, so a copy starts empty
+    ResultCache(const ResultCache &other);
+
+    ResultCache &operator=(const ResultCache &other);
+
+    std::optional<std::vector<Document>> Find(const ResultCacheKey &key, uint64_t generation);
+
+    void Insert(ResultCacheKey key, uint64_t generation, std::vector<Document> documents);
+
+    // Drops all entries; zero capacity turns the cache off
+    void SetCapacity(std::size_t capacity);
+
+    std::size_t GetCapacity() const;
+
+    ResultCacheStats GetStats() const;
+
+private:
+    static constexpr std::size_t SHARD_COUNT = 16;
+
+    struct KeyHash {
+        std::size_t operator()(const ResultCacheKey &key) const;
+    };
+
+    struct Entry {
+        ResultCacheKey key;
+        uint64_t generation;
+        std::vector<Document> documents;
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        // Most recently used first
+        std::list<Entry> entries;
+        std::unordered_map<ResultCacheKey, std::list<Entry>::iterator, KeyHash> positions;
+    };
+
+    std::size_t capacity_;
+    std::size_t shard_capacity_;
+    std::array<Shard, SHARD_COUNT> shards_;
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+
+    Shard &GetShard(std::size_t hash);
+};
@@ -0,0 +1,47 @@
+#include "score_accumulator.h"
+
+using namespace std;
+
+void ScoreAccumulator::Resize(size_t size) {
+    if (scores_.size() < size) {
+        scores_.resize(size, 0.0);
+        touched_bits_.Resize(size);
+    }
+}
+
+void ScoreAccumulator::Merge(ScoreAccumulator &other) {
+    for (const DocumentOrdinal ordinal: other.touched_) {
+        Add(ordinal, other.scores_[ordinal]);
+    }
+    other.Clear();
+}
+
+void ScoreAccumulator::Clear() {
+    for (const DocumentOrdinal ordinal: touched_) {
+        scores_[ordinal] = 0.0;
+        touched_bits_.Reset(ordinal);
+    }
+    touched_.clear();
+}
+
+unique_ptr<ScoreAccumulator> ScoreAccumulatorPool::Acquire(size_t size) {
+    unique_ptr<ScoreAccumulator> accumulator;
+    {
+        lock_guard guard(mutex_);
+        if (!free_.empty()) {
+            accumulator = move(free_.back());
+            free_.pop_back();
+        }
+    }
+    if (!accumulator) {
+        accumulator = make_unique<ScoreAccumulator>();
+    }
+    accumulator->Resize(size);
+    return accumulator;
+}
+
+void ScoreAccumulatorPool::Release(unique_ptr<ScoreAccumulator> accumulator) {
+    accumulator->Clear();
+    lock_guard guard(mutex_);
+    free_.push_back(move(accumulator));
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "document_bitmap.h"
+#include "posting_list.h"
+
+// Relevance sums in a dense array indexed by DocumentOrdinal. Only the touched slots are
+// reset by Clear, so one accumulator serves many queries without zeroing the whole array
+class ScoreAccumulator {
+public:
+    void Resize(std::size_t size);
+
+    void Add(DocumentOrdinal ordinal, double score) {
+        if (!touched_bits_.Test(ordinal)) {
+            touched_bits_.Set(ordinal);
+            touched_.push_back(ordinal);
+        }
+        scores_[ordinal] += score;
+    }
+
+    // Number of touched documents
+    std::size_t size() const {
+        return touched_.size();
+    }
+
+    // Adds the sums of other to this accumulator and clears other
+    void Merge(ScoreAccumulator &other);
+
+    // function(ordinal, relevance) for every touched document, in the order they were first added
+    template<typename Function>
+    void ForEach(Function function) const {
+        for (const DocumentOrdinal ordinal: touched_) {
+            function(ordinal, scores_[ordinal]);
+        }
+    }
+
+    void Clear();
+
+private:
+    std::vector<double> scores_;
+    DocumentBitmap touched_bits_;
+    std::vector<DocumentOrdinal> touched_;
+};
+
+// Cleared accumulators kept for reuse. The lock is taken once per Acquire/Release, never per posting
+class ScoreAccumulatorPool {
+public:
+    ScoreAccumulatorPool() = default;
+
+    // Accumulators hold no index data, so a copy starts with an empty pool
+    ScoreAccumulatorPool(const ScoreAccumulatorPool &) {
+    }
+
+    ScoreAccumulatorPool &operator=(const ScoreAccumulatorPool &) {
+        return *this;
+    }
+
+    // A cleared accumulator with room for `size` ordinals
+    std::unique_ptr<ScoreAccumulator> Acquire(std::size_t size);
+
+    void Release(std::unique_ptr<ScoreAccumulator> accumulator);
+
+private:
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<ScoreAccumulator>> free_;
+};
@@ -2,86 +2,291 @@
 
 using namespace std;
 
+namespace {
+
+// Calls function(index) for every index of document_terms that holds one of the query terms.
+// Both are sorted and distinct; each query term gallops ahead from the previous match, so a
+// short query costs O(q log d) rather than a walk over the whole document
+template<typename Function>
+void ForEachCommonTerm(const vector<TermId> &document_terms, const TermId *query_first, const TermId *query_last,
+                       Function function) {
+    const size_t size = document_terms.size();
+    size_t position = 0;
+    for (; query_first != query_last && position < size; ++query_first) {
+        const TermId term_id = *query_first;
+        // every term before low is smaller than term_id, and the term at high isn't
+        size_t low = position;
+        size_t high = position;
+        for (size_t step = 1; high < size && document_terms[high] < term_id; step *= 2) {
+            low = high + 1;
+            high += step;
+        }
+        position = lower_bound(document_terms.begin() + low, document_terms.begin() + min(high, size), term_id)
+                   - document_terms.begin();
+        if (position < size && document_terms[position] == term_id) {
+            function(position++);
+        }
+    }
+}
+
+}
+
 SearchServer::SearchServer(const std::string_view stop_words_text) {
     for (char ch: stop_words_text) {
         if (iscntrl(ch)) {
             throw invalid_argument("");
         }
     }
-    for (auto &n: SplitIntoWords(stop_words_text)) {
-        stop_words_.emplace(n.begin(), n.end());
+    set<string> stop_words;
+    for (const Token &token: SplitIntoTokens(stop_words_text)) {
+        stop_words.emplace(token.word);
     }
+    stop_words_ = StopWordSet(stop_words);
 
 }
 
 SearchServer::SearchServer(const std::string &stop_words_text) : SearchServer(std::string_view(stop_words_text)) {}
 
 
-void SearchServer::AddDocument(int document_id,
-                               const std::string_view document,
-                               DocumentStatus status,
-                               const std::vector<int> &ratings) {
-    if ((document_id < 0) || (documents_.count(document_id) > 0)) {
+optional<int> SearchServer::AddDocument(int document_id,
+                                        const std::string_view document,
+                                        DocumentStatus status,
+                                        const std::vector<int> &ratings) {
+    if ((document_id < 0) || (id_to_ordinal_.count(document_id) > 0)) {
         throw std::invalid_argument("Invalid document_id");
     }
 
-    storage_.emplace_back(document.begin(), document.end());
-
+    // every word is checked before any of them reaches the dictionary
+    const auto tokens = SplitIntoTokens(document);
+    const auto invalid_token = find_if(tokens.begin(), tokens.end(), [](const Token &token) {
+        return !token.is_valid;
+    });
+    if (invalid_token != tokens.end()) {
+        throw std::invalid_argument("Word "s + std::string(invalid_token->word) + " is invalid"s);
+    }
 
-    const auto words = SplitIntoWordsNoStop(storage_.back());
+    vector<TermId> words;
+    for (const Token &token: tokens) {
+        if (!IsStopWord(token.word)) {
+            words.push_back(terms_.Insert(token.word));
+        }
+    }
+    if (term_postings_.size() < terms_.size()) {
+        term_postings_.resize(terms_.size());
+        inverse_document_freqs_.resize(terms_.size());
+        tombstoned_postings_.resize(terms_.size());
+    }
 
-    const double inv_word_count = 1.0 / words.size();
-    for (const auto word: words) {
-        word_to_document_freqs_[word][document_id] += inv_word_count;
+    DocumentData document_data;
+    document_data.word_count = static_cast<uint32_t>(words.size());
+    sort(words.begin(), words.end());
+    for (auto first = words.begin(); first != words.end();) {
+        const auto last = upper_bound(first, words.end(), *first);
+        document_data.term_ids.push_back(*first);
+        document_data.term_counts.push_back(static_cast<uint32_t>(last - first));
+        first = last;
     }
 
-    map<string_view, double> w_f;
-    for (auto w: words) {
-        if (!w_f.count(w)) {
-            double inv_word_count = (count(words.begin(), words.end(), w) * 1.0) / words.size();
-            w_f[w] = inv_word_count;
-            word_to_document_freqs_[w][document_id] = inv_word_count;
+    // a duplicate has no word the dictionary hasn't seen, so rejecting it leaves the dictionary as it was
+    optional<int> original_id;
+    TermSetFingerprint fingerprint;
+    if (duplicate_handling_ != DuplicateHandling::ALLOW) {
+        fingerprint = ComputeTermSetFingerprint(document_data.term_ids);
+        original_id = FindSameWords(fingerprint, document_data.term_ids);
+        if (original_id && duplicate_handling_ == DuplicateHandling::REJECT) {
+            return original_id;
         }
     }
-    documents_.emplace(document_id, DocumentData{ComputeAverageRating(ratings), status, w_f});
-    document_ids_.push_back(document_id);
+
+    const auto ordinal = static_cast<DocumentOrdinal>(documents_.size());
+    for (size_t i = 0; i < document_data.term_ids.size(); ++i) {
+        term_postings_[document_data.term_ids[i]].Add(ordinal, document_data.term_counts[i],
+                                                       document_data.word_count);
+    }
+    documents_.push_back(move(document_data));
+    document_texts_.push_back(text_arena_.Store(document));
+    ratings_.push_back(ComputeAverageRating(ratings));
+    statuses_.push_back(static_cast<uint8_t>(status));
+    for (auto &status_bitmap: status_bitmaps_) {
+        status_bitmap.Resize(documents_.size());
+    }
+    tombstones_.Resize(documents_.size());
+    status_bitmaps_[static_cast<size_t>(status)].Set(ordinal);
+    ordinal_to_id_.push_back(document_id);
+    id_to_ordinal_.emplace(document_id, ordinal);
+    document_ids_.insert(upper_bound(document_ids_.begin(), document_ids_.end(), document_id), document_id);
+    if (duplicate_handling_ != DuplicateHandling::ALLOW) {
+        word_set_fingerprints_.emplace(fingerprint, document_id);
+    }
+    ++index_generation_;
+    impact_index_.reset();
+    return original_id;
 }
 
-std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, DocumentStatus status) const {
-    return FindTopDocuments(
-            std::execution::seq, raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
-                return document_status == status;
-            });
+std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, DocumentStatus status,
+                                                     size_t k, size_t offset) const {
+    return FindTopDocuments(std::execution::seq, raw_query, status, k, offset);
 }
 
 std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query) const {
     return FindTopDocuments(execution::seq, raw_query, DocumentStatus::ACTUAL);
 }
 
+SearchServer::PreparedQuery SearchServer::PrepareQuery(const std::string_view raw_query) const {
+    PreparedQuery prepared_query;
+    prepared_query.query_ = ParseQuery(raw_query);
+    prepared_query.excluded_ = BuildExclusionBitmap(prepared_query.query_);
+    prepared_query.index_generation_ = index_generation_;
+    return prepared_query;
+}
+
+std::vector<Document> SearchServer::FindTopDocuments(const PreparedQuery &prepared_query, DocumentStatus status,
+                                                     size_t k, size_t offset) const {
+    return FindTopDocuments(execution::seq, prepared_query, status, k, offset);
+}
+
+std::vector<Document> SearchServer::FindTopDocuments(const PreparedQuery &prepared_query) const {
+    return FindTopDocuments(execution::seq, prepared_query, DocumentStatus::ACTUAL);
+}
+
+void SearchServer::CheckIsCurrent(const PreparedQuery &prepared_query) const {
+    if (prepared_query.index_generation_ != index_generation_) {
+        throw std::invalid_argument("Prepared query is out of date");
+    }
+}
+
 
 int SearchServer::GetDocumentCount() const {
-    return documents_.size();
+    return id_to_ordinal_.size();
+}
+
+IndexStats SearchServer::GetIndexStats() const {
+    IndexStats stats;
+    stats.term_count = terms_.size();
+    stats.posting_bytes = term_postings_.capacity() * sizeof(PostingList);
+    for (const auto &postings: term_postings_) {
+        stats.posting_count += postings.size();
+        stats.posting_bytes += postings.GetMemoryUsage() - sizeof(PostingList);
+    }
+    if (impact_index_) {
+        stats.impact_bytes = impact_index_->GetMemoryUsage();
+    }
+    stats.text_bytes = text_arena_.GetAllocatedBytes();
+    stats.live_text_bytes = text_arena_.GetLiveBytes();
+    return stats;
+}
+
+void SearchServer::SetQueryEvaluation(QueryEvaluation query_evaluation) {
+    query_evaluation_ = query_evaluation;
+}
+
+void SearchServer::SetRemovalMode(RemovalMode removal_mode) {
+    removal_mode_ = removal_mode;
+    if (removal_mode_ == RemovalMode::IMMEDIATE) {
+        PurgeRemovedDocuments();
+    }
+}
+
+size_t SearchServer::GetRemovedDocumentCount() const {
+    return tombstone_count_;
+}
+
+bool SearchServer::NeedsPurge() const {
+    // a chunk of texts is freed once all of its texts are released; moving the texts out of sparse
+    // chunks is left to the purge as well
+    return (tombstone_count_ >= MIN_ORDINALS_TO_COMPACT && tombstone_count_ * 8 >= documents_.size())
+           || (tombstone_count_ > 0 && text_arena_.NeedsCompaction());
+}
+
+void SearchServer::PurgeRemovedDocuments() {
+    PurgeRemovedDocuments(execution::seq);
+}
+
+void SearchServer::SetDuplicateHandling(DuplicateHandling duplicate_handling) {
+    if (duplicate_handling == DuplicateHandling::ALLOW) {
+        word_set_fingerprints_.clear();
+    } else if (duplicate_handling_ == DuplicateHandling::ALLOW) {
+        word_set_fingerprints_.reserve(id_to_ordinal_.size());
+        for (const auto &[document_id, ordinal]: id_to_ordinal_) {
+            word_set_fingerprints_.emplace(ComputeTermSetFingerprint(documents_[ordinal].term_ids), document_id);
+        }
+    }
+    duplicate_handling_ = duplicate_handling;
+}
+
+void SearchServer::SetResultCacheCapacity(size_t capacity) {
+    result_cache_.SetCapacity(capacity);
+}
+
+ResultCacheStats SearchServer::GetResultCacheStats() const {
+    return result_cache_.GetStats();
+}
+
+void SearchServer::BuildImpactIndex() {
+    // the impacts are computed from the postings, which must not include tombstoned documents
+    PurgeRemovedDocuments();
+    vector<double> inverse_document_freqs(term_postings_.size());
+    for (TermId term_id = 0; term_id < term_postings_.size(); ++term_id) {
+        if (!term_postings_[term_id].empty()) {
+            inverse_document_freqs[term_id] = ComputeWordInverseDocumentFreq(term_id);
+        }
+    }
+    impact_index_ = make_shared<const ImpactIndex>(term_postings_, inverse_document_freqs);
 }
 
 vector<int>::const_iterator SearchServer::begin() {
+    PurgeRemovedIds();
     return document_ids_.begin();
 }
 
 vector<int>::const_iterator SearchServer::end() {
+    PurgeRemovedIds();
     return document_ids_.end();
 }
 
-const map<string_view, double> &SearchServer::GetWordFrequencies(int document_id) const {
-    if (documents_.count(document_id) > 0) {
-        return documents_.at(document_id).document_words_;
+map<string_view, double> SearchServer::GetWordFrequencies(int document_id) const {
+    map<string_view, double> word_freqs;
+    const auto ordinal = id_to_ordinal_.find(document_id);
+    if (ordinal != id_to_ordinal_.end()) {
+        const DocumentData &document = documents_[ordinal->second];
+        for (size_t i = 0; i < document.term_ids.size(); ++i) {
+            word_freqs.emplace(terms_.GetTerm(document.term_ids[i]),
+                               static_cast<double>(document.term_counts[i]) / document.word_count);
+        }
     }
-    static const map<string_view, double> ans;
-    return ans;
+    return word_freqs;
+}
+
+
+string_view SearchServer::GetDocumentText(int document_id) const {
+    const auto ordinal = id_to_ordinal_.find(document_id);
+    if (ordinal != id_to_ordinal_.end()) {
+        return text_arena_.Get(document_texts_[ordinal->second]);
+    }
+    return {};
+}
+
+TermSetFingerprint SearchServer::GetWordSetFingerprint(int document_id) const {
+    const auto ordinal = id_to_ordinal_.find(document_id);
+    if (ordinal != id_to_ordinal_.end()) {
+        return ComputeTermSetFingerprint(documents_[ordinal->second].term_ids);
+    }
+    return {};
+}
+
+bool SearchServer::HaveSameWords(int document_id, int other_document_id) const {
+    const auto ordinal = id_to_ordinal_.find(document_id);
+    const auto other_ordinal = id_to_ordinal_.find(other_document_id);
+    if (ordinal == id_to_ordinal_.end() || other_ordinal == id_to_ordinal_.end()) {
+        return false;
+    }
+    // the forward index keeps the term ids sorted
+    return documents_[ordinal->second].term_ids == documents_[other_ordinal->second].term_ids;
 }
 
 
 bool SearchServer::IsStopWord(const std::string_view word) const {
-    return stop_words_.count(word) > 0;
+    return stop_words_.Contains(word);
 }
 
 bool SearchServer::IsValidWord(const std::string_view word) {
@@ -90,19 +295,6 @@ bool SearchServer::IsValidWord(const std::string_view word) {
     });
 }
 
-std::vector<std::string_view> SearchServer::SplitIntoWordsNoStop(const std::string &text) const {
-    std::vector<std::string_view> words;
-    for (const auto &word: SplitIntoWords(text)) {
-        if (!IsValidWord(word)) {
-            throw std::invalid_argument("Word "s + std::string(word) + " is invalid"s);
-        }
-        if (!IsStopWord(word)) {
-            words.push_back(word);
-        }
-    }
-    return words;
-}
-
 int SearchServer::ComputeAverageRating(const std::vector<int> &ratings) {
     if (ratings.empty()) {
         return 0;
@@ -114,7 +306,8 @@ int SearchServer::ComputeAverageRating(const std::vector<int> &ratings) {
     return rating_sum / static_cast<int>(ratings.size());
 }
 
-SearchServer::QueryWord SearchServer::ParseQueryWord(const std::string_view text) const {
+SearchServer::QueryWord SearchServer::ParseQueryWord(const Token &token) const {
+    const std::string_view text = token.word;
     if (text.empty()) {
         throw std::invalid_argument("Query word is empty");
     }
@@ -124,41 +317,53 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(const std::string_view text
         is_minus = true;
         word = word.substr(1);
     }
-    if (word.empty() || word[0] == '-' || !IsValidWord(word)) {
+    if (word.empty() || word[0] == '-' || !token.is_valid) {
         throw std::invalid_argument("Query word " + std::string(text) + " is invalid");
     }
 
     return {word, is_minus, IsStopWord(word)};
 }
 
-SearchServer::Query SearchServer::ParseQuery(const std::string_view text, bool to_sort) const {
+SearchServer::Query SearchServer::ParseQuery(const std::string_view text) const {
     Query result;
 
-    for (const auto &word: SplitIntoWords(text)) {
-        const auto query_word = ParseQueryWord(word);
-        if (!query_word.is_stop) {
-            if (query_word.is_minus) {
-                result.minus_words.push_back(query_word.data);
-            } else {
-                result.plus_words.push_back(query_word.data);
-            }
+    for (const Token &token: SplitIntoTokens(text)) {
+        const auto query_word = ParseQueryWord(token);
+        if (query_word.is_stop) {
+            continue;
+        }
+        const TermId term_id = terms_.Find(query_word.data);
+        if (term_id == TermDictionary::NO_TERM) {
+            continue;
+        }
+        if (query_word.is_minus) {
+            result.minus_terms.push_back(term_id);
+        } else {
+            result.plus_terms.push_back(term_id);
         }
     }
 
-    if (to_sort) {
-        std::sort(result.plus_words.begin(), result.plus_words.end());
-        std::sort(result.minus_words.begin(), result.minus_words.end());
-        auto last = std::unique(result.plus_words.begin(), result.plus_words.end());
-        result.plus_words.erase(last, result.plus_words.end());
-        last = std::unique(result.minus_words.begin(), result.minus_words.end());
-        result.minus_words.erase(last, result.minus_words.end());
-    }
+    std::sort(result.plus_terms.begin(), result.plus_terms.end());
+    std::sort(result.minus_terms.begin(), result.minus_terms.end());
+    auto last = std::unique(result.plus_terms.begin(), result.plus_terms.end());
+    result.plus_terms.erase(last, result.plus_terms.end());
+    last = std::unique(result.minus_terms.begin(), result.minus_terms.end());
+    result.minus_terms.erase(last, result.minus_terms.end());
 
     return result;
 }
 
-double SearchServer::ComputeWordInverseDocumentFreq(const std::string_view word) const {
-    return log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(word).size());
+double SearchServer::ComputeWordInverseDocumentFreq(TermId term_id) const {
+    auto &cached = inverse_document_freqs_[term_id];
+    if (cached.generation.load(memory_order_acquire) == index_generation_) {
+        return cached.value.load(memory_order_relaxed);
+    }
+    // a term whose documents are all tombstoned matches nothing
+    const size_t document_freq = term_postings_[term_id].size() - tombstoned_postings_[term_id];
+    const double inverse_document_freq = document_freq == 0 ? 0.0 : log(GetDocumentCount() * 1.0 / document_freq);
+    cached.value.store(inverse_document_freq, memory_order_relaxed);
+    cached.generation.store(index_generation_, memory_order_release);
+    return inverse_document_freq;
 }
 
 void AddDocument(SearchServer &ss, int document_id, const std::string &document, DocumentStatus status,
@@ -166,90 +371,215 @@ void AddDocument(SearchServer &ss, int document_id, const std::string &document,
     ss.AddDocument(document_id, document, status, ratings);
 }
 
-void SearchServer::RemoveDocument(int document_id) {
-    for (auto &wrds: documents_[document_id].document_words_) {
-        word_to_document_freqs_[wrds.first].erase(document_id);
-        if (word_to_document_freqs_[wrds.first].empty()) {
-            word_to_document_freqs_.erase(wrds.first);
-        }
+double SearchServer::ComputeRelevance(DocumentOrdinal ordinal, const Query &query) const {
+    const DocumentData &document = documents_[ordinal];
+    double relevance = 0.0;
+    ForEachCommonTerm(document.term_ids, query.plus_terms.begin(), query.plus_terms.end(),
+                      [&](size_t index) {
+                          const double term_freq = static_cast<double>(document.term_counts[index])
+                                                   / document.word_count;
+                          relevance += term_freq * ComputeWordInverseDocumentFreq(document.term_ids[index]);
+                      });
+    return relevance;
+}
+
+DocumentBitmap SearchServer::BuildExclusionBitmap(const Query &query) const {
+    // most queries exclude nothing, and filling a bit per document would cost more than the query
+    if (query.minus_terms.empty()) {
+        return {};
     }
-    document_ids_.erase(lower_bound(document_ids_.begin(), document_ids_.end(), document_id));
-    documents_.erase(document_id);
+    DocumentBitmap excluded;
+    excluded.Resize(documents_.size());
+    for (const TermId term_id: query.minus_terms) {
+        term_postings_[term_id].ForEach([&excluded](DocumentOrdinal ordinal, double) {
+            excluded.Set(ordinal);
+        });
+    }
+    return excluded;
+}
 
+void SearchServer::RemoveDocument(int document_id) {
+    RemoveDocument(execution::seq, document_id);
 }
 
 void SearchServer::RemoveDocument(std::execution::sequenced_policy, int document_id) {
-
-    for (auto &wrds: documents_[document_id].document_words_) {
-        word_to_document_freqs_[wrds.first].erase(document_id);
-        if (word_to_document_freqs_[wrds.first].empty()) {
-            word_to_document_freqs_.erase(wrds.first);
-        }
+    const auto it = id_to_ordinal_.find(document_id);
+    if (it == id_to_ordinal_.end()) {
+        return;
     }
-    document_ids_.erase(lower_bound(document_ids_.begin(), document_ids_.end(), document_id));
-    documents_.erase(document_id);
-
-
+    const DocumentOrdinal ordinal = it->second;
+    if (removal_mode_ == RemovalMode::DEFERRED) {
+        AddTombstone(ordinal);
+        return;
+    }
+    for (const TermId term_id: documents_[ordinal].term_ids) {
+        term_postings_[term_id].Remove(ordinal);
+    }
+    ReleaseOrdinal(ordinal);
 }
 
 void SearchServer::RemoveDocument(std::execution::parallel_policy, int document_id) {
+    const auto it = id_to_ordinal_.find(document_id);
+    if (it == id_to_ordinal_.end()) {
+        return;
+    }
+    const DocumentOrdinal ordinal = it->second;
+    if (removal_mode_ == RemovalMode::DEFERRED) {
+        AddTombstone(ordinal);
+        return;
+    }
+    const std::vector<TermId> &term_ids = documents_[ordinal].term_ids;
 
+    std::for_each(std::execution::par, term_ids.begin(), term_ids.end(),
+                  [this, ordinal](TermId term_id) { term_postings_[term_id].Remove(ordinal); });
 
-    const std::map<std::string_view, double> &word_freqs = documents_.at(document_id).document_words_;
-
-    std::vector<const std::string_view *> words_to_erase(word_freqs.size());
-
-    std::transform(std::execution::par, word_freqs.begin(), word_freqs.end(),
-                   words_to_erase.begin(),
-                   [](const auto &words_freq) { return &words_freq.first; });
-
-    std::for_each(std::execution::par, words_to_erase.begin(), words_to_erase.end(),
-                  [this, document_id](const auto &word) { word_to_document_freqs_.at(*word).erase(document_id); });
+    ReleaseOrdinal(ordinal);
+}
 
+void SearchServer::RemoveDocuments(const std::vector<int> &document_ids) {
+    RemoveDocuments(execution::seq, document_ids);
+}
 
+void SearchServer::ReleaseOrdinal(DocumentOrdinal ordinal) {
+    const int document_id = ordinal_to_id_[ordinal];
     document_ids_.erase(lower_bound(document_ids_.begin(), document_ids_.end(), document_id));
-    documents_.erase(document_id);
-
+    ClearOrdinal(ordinal);
+    FinishRemoval();
+}
 
+void SearchServer::ClearOrdinal(DocumentOrdinal ordinal) {
+    UnlinkDocument(ordinal);
+    documents_[ordinal] = DocumentData{};
 }
 
-std::tuple<std::vector<std::string_view>, DocumentStatus>
-SearchServer::MatchDocument(std::execution::parallel_policy, const std::string_view raw_query, int document_id) const {
+void SearchServer::UnlinkDocument(DocumentOrdinal ordinal) {
+    ForgetWordSet(ordinal);
+    id_to_ordinal_.erase(ordinal_to_id_[ordinal]);
+    text_arena_.Release(document_texts_[ordinal]);
+    document_texts_[ordinal] = {TextArena::NO_CHUNK, 0, 0};
+    status_bitmaps_[statuses_[ordinal]].Reset(ordinal);
+    ordinal_to_id_[ordinal] = REMOVED_DOCUMENT_ID;
+}
 
+void SearchServer::FinishRemoval() {
+    ++index_generation_;
+    impact_index_.reset();
 
-    if (!std::count(document_ids_.begin(), document_ids_.end(), document_id)) {
-        throw std::out_of_range("No such document");
+    // Renumber once the holes outweigh the live documents, so the cost is amortized over the removals.
+    // Tombstoned postings would be renumbered as well, so they have to be purged first
+    const size_t removed_count = documents_.size() - id_to_ordinal_.size();
+    if (tombstone_count_ == 0 && removed_count > id_to_ordinal_.size() && removed_count >= MIN_ORDINALS_TO_COMPACT) {
+        CompactOrdinals();
     }
-    //LOG_DURATION_STREAM("Operation time", cerr);
-    const auto query = ParseQuery(raw_query, false);
-
-    std::vector<std::string_view> matched_words;
-    matched_words.reserve(query.plus_words.size());
-
-    if (std::any_of(std::execution::par, query.minus_words.begin(), query.minus_words.end(),
-                    [this, document_id](const auto word) {
-                        return
-                                word_to_document_freqs_.at(word).count(document_id);
-                    })) {
-        return {vector<string_view>(), documents_.at(document_id).status};
+    if (text_arena_.NeedsCompaction()) {
+        text_arena_.Compact(document_texts_);
     }
+}
 
-    matched_words.resize(query.plus_words.size());
+void SearchServer::AddTombstone(DocumentOrdinal ordinal) {
+    removed_ids_.push_back(ordinal_to_id_[ordinal]);
+    UnlinkDocument(ordinal);
+    for (const TermId term_id: documents_[ordinal].term_ids) {
+        ++tombstoned_postings_[term_id];
+    }
+    tombstones_.Set(ordinal);
+    ++tombstone_count_;
+    ++index_generation_;
+    impact_index_.reset();
+}
 
-    auto ll = std::copy_if(std::execution::par, query.plus_words.begin(), query.plus_words.end(),
-                           matched_words.begin(), [this, document_id](const auto word) {
+optional<int> SearchServer::FindSameWords(const TermSetFingerprint &fingerprint,
+                                          const vector<TermId> &term_ids) const {
+    // the term ids are compared as well, so a fingerprint collision can't report a false duplicate
+    const auto [first, last] = word_set_fingerprints_.equal_range(fingerprint);
+    for (auto it = first; it != last; ++it) {
+        if (documents_[id_to_ordinal_.at(it->second)].term_ids == term_ids) {
+            return it->second;
+        }
+    }
+    return nullopt;
+}
 
-                return word_to_document_freqs_.count(word) && word_to_document_freqs_.at(word).count(document_id);
+void SearchServer::ForgetWordSet(DocumentOrdinal ordinal) {
+    if (duplicate_handling_ == DuplicateHandling::ALLOW) {
+        return;
+    }
+    const int document_id = ordinal_to_id_[ordinal];
+    const auto [first, last] = word_set_fingerprints_.equal_range(
+            ComputeTermSetFingerprint(documents_[ordinal].term_ids));
+    for (auto it = first; it != last; ++it) {
+        if (it->second == document_id) {
+            word_set_fingerprints_.erase(it);
+            return;
+        }
+    }
+}
 
-            });
+void SearchServer::PurgeRemovedIds() {
+    if (removed_ids_.empty()) {
+        return;
+    }
+    // a removed id may have been added again; set_difference drops only one copy per removal
+    sort(removed_ids_.begin(), removed_ids_.end());
+    vector<int> remaining_ids;
+    remaining_ids.reserve(document_ids_.size() - removed_ids_.size());
+    set_difference(document_ids_.begin(), document_ids_.end(), removed_ids_.begin(), removed_ids_.end(),
+                   back_inserter(remaining_ids));
+    document_ids_ = move(remaining_ids);
+    removed_ids_.clear();
+}
 
-    std::sort(execution::par, matched_words.begin(), ll);
+void SearchServer::CompactOrdinals() {
+    vector<DocumentOrdinal> new_ordinals(documents_.size());
+    DocumentOrdinal next_ordinal = 0;
+    for (DocumentOrdinal ordinal = 0; ordinal < documents_.size(); ++ordinal) {
+        if (ordinal_to_id_[ordinal] == REMOVED_DOCUMENT_ID) {
+            continue;
+        }
+        new_ordinals[ordinal] = next_ordinal;
+        if (next_ordinal != ordinal) {
+            documents_[next_ordinal] = move(documents_[ordinal]);
+            document_texts_[next_ordinal] = document_texts_[ordinal];
+            ratings_[next_ordinal] = ratings_[ordinal];
+            statuses_[next_ordinal] = statuses_[ordinal];
+            ordinal_to_id_[next_ordinal] = ordinal_to_id_[ordinal];
+            id_to_ordinal_[ordinal_to_id_[next_ordinal]] = next_ordinal;
+        }
+        ++next_ordinal;
+    }
+    documents_.resize(next_ordinal);
+    document_texts_.resize(next_ordinal);
+    ratings_.resize(next_ordinal);
+    statuses_.resize(next_ordinal);
+    ordinal_to_id_.resize(next_ordinal);
+    for (auto &postings: term_postings_) {
+        postings.Remap(new_ordinals);
+    }
+    RebuildStatusBitmaps();
+    tombstones_.Resize(next_ordinal);
+}
 
-    auto last = std::unique(matched_words.begin(), ll);
-    matched_words.erase(last, matched_words.end());
+void SearchServer::RebuildStatusBitmaps() {
+    for (size_t status = 0; status < DOCUMENT_STATUS_COUNT; ++status) {
+        status_bitmaps_[status].Fill(statuses_.size(), [this, status](DocumentOrdinal ordinal) {
+            return statuses_[ordinal] == status;
+        });
+    }
+}
 
+DocumentOrdinal SearchServer::GetOrdinal(int document_id) const {
+    const auto it = id_to_ordinal_.find(document_id);
+    if (it == id_to_ordinal_.end()) {
+        throw std::out_of_range("No such document");
+    }
+    return it->second;
+}
 
-    return {matched_words, documents_.at(document_id).status};
+// The query words are looked up in the sorted forward index of the document, so matching
+// doesn't touch the posting lists; the parallel overload has too little work to split
+std::tuple<std::vector<std::string_view>, DocumentStatus>
+SearchServer::MatchDocument(std::execution::parallel_policy, const std::string_view raw_query, int document_id) const {
+    return MatchDocument(raw_query, document_id);
 }
 
 std::tuple<std::vector<std::string_view>, DocumentStatus>
@@ -262,30 +592,43 @@ SearchServer::MatchDocument(std::execution::sequenced_policy, const std::string_
 std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(const std::string_view raw_query,
                                                                                       int document_id) const {
 
-    if (!std::count(document_ids_.begin(), document_ids_.end(), document_id)) {
-        throw std::out_of_range("No such document");
-    }
-    //LOG_DURATION_STREAM("Operation time", cerr);
+    const DocumentOrdinal ordinal = GetOrdinal(document_id);
     const auto query = ParseQuery(raw_query);
-
-    std::vector<std::string_view> matched_words;
-
-    if (std::any_of(query.minus_words.begin(), query.minus_words.end(), [this, document_id](const auto &word) {
-        return (word_to_document_freqs_.count(word) != 0) && word_to_document_freqs_.at(word).count(document_id);
-    })) {
-        return {vector<string_view>(), documents_.at(document_id).status};
+    if (HasMinusWord(ordinal, query)) {
+        return {vector<string_view>(), static_cast<DocumentStatus>(statuses_[ordinal])};
     }
+    return {GetMatchedWords(ordinal, query), static_cast<DocumentStatus>(statuses_[ordinal])};
+}
 
-    for (const auto word: query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
-        }
-        if (word_to_document_freqs_.at(word).count(document_id)) {
-            matched_words.push_back(word);
-        }
-    }
+std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>>
+SearchServer::MatchDocuments(const std::string_view raw_query, const std::vector<int> &document_ids) const {
+    return MatchDocuments(execution::seq, raw_query, document_ids);
+}
 
-    return {matched_words, documents_.at(document_id).status};
+bool SearchServer::HasMinusWord(DocumentOrdinal ordinal, const Query &query) const {
+    bool has_minus_word = false;
+    ForEachCommonTerm(documents_[ordinal].term_ids, query.minus_terms.begin(), query.minus_terms.end(),
+                      [&has_minus_word](size_t) {
+                          has_minus_word = true;
+                      });
+    return has_minus_word;
 }
 
+std::vector<std::string_view> SearchServer::GetMatchedWords(DocumentOrdinal ordinal, const Query &query) const {
+    const std::vector<TermId> &term_ids = documents_[ordinal].term_ids;
+    std::vector<TermId> matched_terms;
+    ForEachCommonTerm(term_ids, query.plus_terms.begin(), query.plus_terms.end(), [&](size_t index) {
+        matched_terms.push_back(term_ids[index]);
+    });
+    return GetTermWords(matched_terms);
+}
 
+std::vector<std::string_view> SearchServer::GetTermWords(const std::vector<TermId> &term_ids) const {
+    std::vector<std::string_view> words;
+    words.reserve(term_ids.size());
+    for (const TermId term_id: term_ids) {
+        words.push_back(terms_.GetTerm(term_id));
+    }
+    std::sort(words.begin(), words.end());
+    return words;
+}
@@ -5,55 +5,187 @@
 #include "string_processing.h"
 #include <stdexcept>
 #include <map>
+#include <optional>
 #include <algorithm>
 #include <cmath>
 #include "log_duration.h"
 #include <vector>
 #include <execution>
+#include <functional>
+#include <iterator>
 #include <string_view>
-#include <list>
+#include <array>
+#include <atomic>
+#include <limits>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <memory>
 #include <mutex>
-#include "concurrent_map.h"
+#include <numeric>
+#include <thread>
+#include "document_bitmap.h"
+#include "impact_index.h"
+#include "posting_list.h"
+#include "result_cache.h"
+#include "score_accumulator.h"
+#include "small_vector.h"
+#include "stop_word_set.h"
+#include "term_dictionary.h"
+#include "term_set_fingerprint.h"
+#include "text_arena.h"
+#include "top_documents.h"
 
 
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
-const auto EPSILON = 1e-6;
+
+// How FindTopDocuments walks the posting lists; every mode returns the same documents as EXHAUSTIVE.
+// BLOCK_MAX skips documents whose score bound can't reach the current top; under a parallel policy
+// it splits the ordinal space into ranges that are evaluated on all cores, each with its own top.
+// IMPACT_ORDERED reads the index built by BuildImpactIndex highest impact first and stops once the
+// remaining impacts can't change the top; while there is no such index it works like BLOCK_MAX
+enum class QueryEvaluation {
+    EXHAUSTIVE,
+    BLOCK_MAX,
+    IMPACT_ORDERED,
+};
+
+// IMMEDIATE removes the postings of a document in RemoveDocument. DEFERRED only marks the
+// document with a tombstone, which hides it from every query at once, and releases its text.
+// Its postings stay until PurgeRemovedDocuments sweeps them together; the server never does
+// that by itself, so the caller, e.g. a maintenance task between writes, polls NeedsPurge
+enum class RemovalMode {
+    IMMEDIATE,
+    DEFERRED,
+};
+
+// What AddDocument does with a document whose set of words is the same as an indexed document's.
+// REPORT indexes it, REJECT leaves it out; both return the id of the indexed document
+enum class DuplicateHandling {
+    ALLOW,
+    REPORT,
+    REJECT,
+};
+
+struct IndexStats {
+    size_t term_count = 0;
+    size_t posting_count = 0;
+    size_t posting_bytes = 0;
+    // Zero while there is no impact index
+    size_t impact_bytes = 0;
+    // Bytes held by the text arena, and how many of them belong to indexed documents
+    size_t text_bytes = 0;
+    size_t live_text_bytes = 0;
+};
 
 class SearchServer {
 public:
+    class PreparedQuery;
+
     template<typename StringContainer>
     explicit SearchServer(const StringContainer &stop_words);   // Extract non-empty stop words
     explicit SearchServer(const std::string &stop_words_text);
 
     explicit SearchServer(const std::string_view stop_words);
 
-    void AddDocument(int document_id, const std::string_view document, DocumentStatus status,
-                     const std::vector<int> &ratings);
+    // Returns the id of an indexed document with the same set of words, unless duplicate handling is
+    // ALLOW
+    std::optional<int> AddDocument(int document_id, const std::string_view document, DocumentStatus status,
+                                   const std::vector<int> &ratings);
 
 
+    // The predicate and status overloads return up to k documents, starting at the offset-th best one.
+    // Once SetResultCacheCapacity turns the result cache on, status queries are answered from it while
+    // the document set is unchanged
     template<typename DocumentPredicate>
-    std::vector<Document> FindTopDocuments(const std::string_view raw_query,
-                                           DocumentPredicate document_predicate) const;
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate,
+                                           size_t k = MAX_RESULT_DOCUMENT_COUNT, size_t offset = 0) const;
 
-    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentStatus status) const;
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentStatus status,
+                                           size_t k = MAX_RESULT_DOCUMENT_COUNT, size_t offset = 0) const;
 
     std::vector<Document> FindTopDocuments(const std::string_view raw_query) const;
 
 
     template<typename DocumentPredicate, typename ExecutionPolicy>
     std::vector<Document> FindTopDocuments(ExecutionPolicy policy, const std::string_view raw_query,
-                                           DocumentPredicate document_predicate) const;
+                                           DocumentPredicate document_predicate,
+                                           size_t k = MAX_RESULT_DOCUMENT_COUNT, size_t offset = 0) const;
 
     template<typename ExecutionPolicy>
     std::vector<Document>
-    FindTopDocuments(ExecutionPolicy policy, const std::string_view raw_query, DocumentStatus status) const;
+    FindTopDocuments(ExecutionPolicy policy, const std::string_view raw_query, DocumentStatus status,
+                     size_t k = MAX_RESULT_DOCUMENT_COUNT, size_t offset = 0) const;
 
     template<typename ExecutionPolicy>
     std::vector<Document> FindTopDocuments(ExecutionPolicy policy, const std::string_view raw_query) const;
 
 
+    // Parses and resolves the query once, for running it with different filters or k. The result
+    // is tied to the current document set: AddDocument and RemoveDocument make it stale
+    PreparedQuery PrepareQuery(const std::string_view raw_query) const;
+
+    template<typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(const PreparedQuery &prepared_query, DocumentPredicate document_predicate,
+                                           size_t k = MAX_RESULT_DOCUMENT_COUNT, size_t offset = 0) const;
+
+    std::vector<Document> FindTopDocuments(const PreparedQuery &prepared_query, DocumentStatus status,
+                                           size_t k = MAX_RESULT_DOCUMENT_COUNT, size_t offset = 0) const;
+
+    std::vector<Document> FindTopDocuments(const PreparedQuery &prepared_query) const;
+
+    template<typename DocumentPredicate, typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy policy, const PreparedQuery &prepared_query,
+                                           DocumentPredicate document_predicate,
+                                           size_t k = MAX_RESULT_DOCUMENT_COUNT, size_t offset = 0) const;
+
+    template<typename ExecutionPolicy>
+    std::vector<Document>
+    FindTopDocuments(ExecutionPolicy policy, const PreparedQuery &prepared_query, DocumentStatus status,
+                     size_t k = MAX_RESULT_DOCUMENT_COUNT, size_t offset = 0) const;
+
+    template<typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy policy, const PreparedQuery &prepared_query) const;
+
+
     int GetDocumentCount() const;
 
+    // Size of the inverted index, for comparing posting list layouts, and of the stored texts
+    IndexStats GetIndexStats() const;
+
+    void SetQueryEvaluation(QueryEvaluation query_evaluation);
+
+    // Switching to IMMEDIATE purges the pending tombstones
+    void SetRemovalMode(RemovalMode removal_mode);
+
+    // Tombstoned documents whose postings are still in the index
+    size_t GetRemovedDocumentCount() const;
+
+    // True once the tombstoned documents make up an eighth of the index, or their released texts
+    // leave the text storage half empty, so a PurgeRemovedDocuments pays off
+    bool NeedsPurge() const;
+
+    // Sweeps the postings of the tombstoned documents
+    void PurgeRemovedDocuments();
+
+    template<typename ExecutionPolicy>
+    void PurgeRemovedDocuments(ExecutionPolicy policy);
+
+    // Anything but ALLOW keeps a fingerprint of the word set of every document, built from the
+    // indexed documents when it is turned on
+    void SetDuplicateHandling(DuplicateHandling duplicate_handling);
+
+    // Number of status query results kept; zero, the default, turns the cache off. Drops the cached
+    // results
+    void SetResultCacheCapacity(size_t capacity);
+
+    ResultCacheStats GetResultCacheStats() const;
+
+    // Precomputes the quantized impacts used by QueryEvaluation::IMPACT_ORDERED. The impacts depend
+    // on the document count, so the next AddDocument or RemoveDocument drops them; call this again
+    // after a bulk load
+    void BuildImpactIndex();
+
     std::vector<int>::const_iterator begin();
 
     std::vector<int>::const_iterator end();
@@ -69,7 +201,28 @@ public:
     MatchDocument(std::execution::sequenced_policy, const std::string_view raw_query,
                   int document_id) const;
 
-    const std::map<std::string_view, double> &GetWordFrequencies(int document_id) const;
+    // MatchDocument for every id, in the same order, with the query parsed once. An unknown id
+    // throws out_of_range before any document is matched
+    std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>>
+    MatchDocuments(const std::string_view raw_query, const std::vector<int> &document_ids) const;
+
+    template<typename ExecutionPolicy>
+    std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>>
+    MatchDocuments(ExecutionPolicy policy, const std::string_view raw_query,
+                   const std::vector<int> &document_ids) const;
+
+    // Built from the forward index on every call
+    std::map<std::string_view, double> GetWordFrequencies(int document_id) const;
+
+    // The view is invalidated by the next AddDocument or RemoveDocument
+    std::string_view GetDocumentText(int document_id) const;
+
+    // Fingerprint of the set of words of the document; an unknown id gives the fingerprint of an
+    // empty set
+    TermSetFingerprint GetWordSetFingerprint(int document_id) const;
+
+    // Whether both documents are indexed and have the same set of words
+    bool HaveSameWords(int document_id, int other_document_id) const;
 
     void RemoveDocument(int document_id);
 
@@ -77,59 +230,221 @@ public:
 
     void RemoveDocument(std::execution::sequenced_policy, int document_id);
 
+    // Removes all the documents in one sweep over the posting lists they appear in and over the
+    // sorted id list, instead of one sweep per document. Unknown and repeated ids are skipped.
+    // Under RemovalMode::DEFERRED the documents are only tombstoned, like in RemoveDocument
+    void RemoveDocuments(const std::vector<int> &document_ids);
+
+    template<typename ExecutionPolicy>
+    void RemoveDocuments(ExecutionPolicy policy, const std::vector<int> &document_ids);
+
 
 private:
+    static constexpr int REMOVED_DOCUMENT_ID = -1;
+    static constexpr size_t MIN_ORDINALS_TO_COMPACT = 64;
+
+    static constexpr size_t DOCUMENT_STATUS_COUNT = 4;
+
+    // Forward index entry: the distinct terms of the document in ascending id order
+    // and how often each occurs among its word_count non-stop words
     struct DocumentData {
-        int rating;
-        DocumentStatus status;
-        std::map<std::string_view, double> document_words_;
+        std::vector<TermId> term_ids;
+        std::vector<uint32_t> term_counts;
+        uint32_t word_count = 0;
+    };
+
+    // log(N / df) of a term as of index generation `generation`. Readers that find it stale
+    // recompute it; they all store the same value, so the race between them is harmless
+    struct CachedInverseDocumentFreq {
+        std::atomic<uint64_t> generation{0};
+        std::atomic<double> value{0.0};
+
+        CachedInverseDocumentFreq() = default;
+
+        CachedInverseDocumentFreq(const CachedInverseDocumentFreq &other)
+                : generation(other.generation.load(std::memory_order_relaxed)),
+                  value(other.value.load(std::memory_order_relaxed)) {
+        }
     };
 
-    std::list<std::string> storage_;
-    std::set<std::string, std::less<>> stop_words_;
-    std::map<std::string_view, std::map<int, double>> word_to_document_freqs_;
-    std::map<int, DocumentData> documents_;
+    StopWordSet stop_words_;
+    TextArena text_arena_;
+    QueryEvaluation query_evaluation_ = QueryEvaluation::BLOCK_MAX;
+    mutable ScoreAccumulatorPool accumulator_pool_;
+    mutable ResultCache result_cache_;
+    std::shared_ptr<const ImpactIndex> impact_index_;
+    TermDictionary terms_;
+    std::vector<PostingList> term_postings_;
+    // Indexed by TermId
+    mutable std::vector<CachedInverseDocumentFreq> inverse_document_freqs_;
+    // Bumped by every change of the document set
+    uint64_t index_generation_ = 1;
+    // Indexed by DocumentOrdinal; slots of removed documents stay until CompactOrdinals
+    std::vector<DocumentData> documents_;
+    std::vector<TextSpan> document_texts_;
+    std::vector<int32_t> ratings_;
+    std::vector<uint8_t> statuses_;
+    std::array<DocumentBitmap, DOCUMENT_STATUS_COUNT> status_bitmaps_;
+    std::vector<int> ordinal_to_id_;
+    std::unordered_map<int, DocumentOrdinal> id_to_ordinal_;
+    // Sorted external ids of the indexed documents, until PurgeRemovedIds also the ids in removed_ids_
     std::vector<int> document_ids_;
+    RemovalMode removal_mode_ = RemovalMode::IMMEDIATE;
+    DuplicateHandling duplicate_handling_ = DuplicateHandling::ALLOW;
+    // Document ids by the fingerprint of their word set, while duplicate handling is on
+    std::unordered_multimap<TermSetFingerprint, int, TermSetFingerprintHasher> word_set_fingerprints_;
+    DocumentBitmap tombstones_;
+    size_t tombstone_count_ = 0;
+    // Indexed by TermId: postings that belong to tombstoned documents
+    std::vector<uint32_t> tombstoned_postings_;
+    // Ids of tombstoned documents still listed in document_ids_
+    std::vector<int> removed_ids_;
 
     bool IsStopWord(const std::string_view word) const;
 
     static bool IsValidWord(const std::string_view word);
 
-    std::vector<std::string_view> SplitIntoWordsNoStop(const std::string &text) const;
-
     static int ComputeAverageRating(const std::vector<int> &ratings);
 
+    DocumentOrdinal GetOrdinal(int document_id) const;
+
+    void ReleaseOrdinal(DocumentOrdinal ordinal);
+
+    // Drops the document data of a removed ordinal, except its entry in document_ids_
+    void ClearOrdinal(DocumentOrdinal ordinal);
+
+    // Drops the id, status bit, word set fingerprint and text of the document; its postings and
+    // forward index are left to the caller
+    void UnlinkDocument(DocumentOrdinal ordinal);
+
+    // Called once the document set has shrunk; compacts the ordinals and the texts when they are sparse
+    void FinishRemoval();
+
+    // Hides the document from lookups and queries; its postings and forward index stay until
+    // PurgeRemovedDocuments
+    void AddTombstone(DocumentOrdinal ordinal);
+
+    // Drops the ids of tombstoned documents from document_ids_
+    void PurgeRemovedIds();
+
+    std::optional<int> FindSameWords(const TermSetFingerprint &fingerprint,
+                                     const std::vector<TermId> &term_ids) const;
+
+    void ForgetWordSet(DocumentOrdinal ordinal);
+
+    void CompactOrdinals();
+
+    void RebuildStatusBitmaps();
+
     struct QueryWord {
         std::string_view data;
         bool is_minus;
         bool is_stop;
     };
+    // Queries up to this many words are parsed without touching the heap
+    static constexpr size_t INLINE_QUERY_WORD_COUNT = 32;
+
+    // Words missing from the dictionary can't match anything and are dropped while parsing
     struct Query {
-        std::vector<std::string_view> plus_words;
-        std::vector<std::string_view> minus_words;
+        SmallVector<TermId, INLINE_QUERY_WORD_COUNT> plus_terms;
+        SmallVector<TermId, INLINE_QUERY_WORD_COUNT> minus_terms;
     };
 
-    QueryWord ParseQueryWord(const std::string_view text) const;
+    QueryWord ParseQueryWord(const Token &token) const;
 
-    Query ParseQuery(const std::string_view text, bool to_sort = true) const;
+    // The terms come out sorted and distinct
+    Query ParseQuery(const std::string_view text) const;
 
-    double ComputeWordInverseDocumentFreq(const std::string_view word) const;
+    double ComputeWordInverseDocumentFreq(TermId term_id) const;
 
+    std::vector<std::string_view> GetTermWords(const std::vector<TermId> &term_ids) const;
 
-    template<typename DocumentPredicate, typename ExecutionPolicy>
+    bool HasMinusWord(DocumentOrdinal ordinal, const Query &query) const;
+
+    // The plus words of the query found in the document, in alphabetical order
+    std::vector<std::string_view> GetMatchedWords(DocumentOrdinal ordinal, const Query &query) const;
+
+
+    // Throws if the document set has changed since the query was prepared
+    void CheckIsCurrent(const PreparedQuery &prepared_query) const;
+
+    template<typename DocumentPredicate>
+    // Tombstoned documents are tested in place, before the predicate could see them
+    auto MakePredicateFilter(DocumentPredicate &document_predicate) const {
+        return [this, &document_predicate, has_tombstones = tombstone_count_ > 0](DocumentOrdinal ordinal) {
+            return !(has_tombstones && tombstones_.Test(ordinal))
+                   && document_predicate(ordinal_to_id_[ordinal], static_cast<DocumentStatus>(statuses_[ordinal]),
+                                         ratings_[ordinal]);
+        };
+    }
+
+    // Tombstoning a document clears its status bit, so this needs no tombstone test
+    auto MakeStatusFilter(DocumentStatus status) const {
+        return [&status_bitmap = status_bitmaps_[static_cast<size_t>(status)]](DocumentOrdinal ordinal) {
+            return status_bitmap.Test(ordinal);
+        };
+    }
+
+    // The cached result of a status query, or the one find_top_documents() returns, which is cached
+    template<typename FindTop>
+    std::vector<Document> FindCachedTopDocuments(const Query &query, DocumentStatus status, size_t k, size_t offset,
+                                                 FindTop find_top_documents) const;
+
+    // OrdinalFilter is called with a DocumentOrdinal and decides whether the document may be returned
+    template<typename OrdinalFilter, typename ExecutionPolicy>
+    std::vector<Document> FindTopOrdinals(ExecutionPolicy policy, const Query &query, const DocumentBitmap &excluded,
+                                          OrdinalFilter ordinal_filter, size_t k, size_t offset) const;
+
+    // Documents with a minus word, built before any plus word is scored
+    // Empty when the query has no minus words, so the evaluators test it only if it is not
+    DocumentBitmap BuildExclusionBitmap(const Query &query) const;
+
+    template<typename OrdinalFilter, typename ExecutionPolicy>
+    std::vector<Document> FindAllDocuments(ExecutionPolicy policy, const Query &query, const DocumentBitmap &excluded,
+                                           OrdinalFilter ordinal_filter) const;
+
+    template<typename OrdinalFilter>
+    std::vector<Document> FindAllDocuments(std::execution::sequenced_policy, const Query &query,
+                                           const DocumentBitmap &excluded, OrdinalFilter ordinal_filter) const;
+
+    template<typename OrdinalFilter>
     std::vector<Document>
-    FindAllDocuments(ExecutionPolicy policy, const Query &query, DocumentPredicate document_predicate) const;
+    FindTopDocumentsPruned(const Query &query, const DocumentBitmap &excluded, OrdinalFilter ordinal_filter,
+                           size_t document_count, DocumentOrdinal first_ordinal, DocumentOrdinal end_ordinal) const;
 
+    // Score-at-a-time over the impact index, with the final scores computed exactly
+    template<typename OrdinalFilter>
+    std::vector<Document>
+    FindTopDocumentsByImpact(const ImpactIndex &impact_index, const Query &query, const DocumentBitmap &excluded,
+                             OrdinalFilter ordinal_filter, size_t document_count) const;
+
+    // Sum of tf * idf over the plus words, added in query order like FindAllDocuments does
+    double ComputeRelevance(DocumentOrdinal ordinal, const Query &query) const;
+
+    template<typename OrdinalFilter, typename ExecutionPolicy>
+    std::vector<Document>
+    FindTopDocumentsPartitioned(ExecutionPolicy policy, const Query &query, const DocumentBitmap &excluded,
+                                OrdinalFilter ordinal_filter, size_t document_count) const;
+
+};
+
+class SearchServer::PreparedQuery {
+private:
+    friend class SearchServer;
+
+    Query query_;
+    // Documents with a minus word; empty when there are none
+    DocumentBitmap excluded_;
+    uint64_t index_generation_ = 0;
 };
 
 template<typename StringContainer>
 SearchServer::SearchServer(const StringContainer &stop_words) {
-    for (auto &w: MakeUniqueNonEmptyStrings(stop_words)) {
-        stop_words_.insert(w);
-    }
-    if (!std::all_of(stop_words_.begin(), stop_words_.end(), IsValidWord)) {
+    const auto unique_stop_words = MakeUniqueNonEmptyStrings(stop_words);
+    if (!std::all_of(unique_stop_words.begin(), unique_stop_words.end(), IsValidWord)) {
         throw std::invalid_argument("Some of stop words are invalid");
     }
+    stop_words_ = StopWordSet(unique_stop_words);
 }
 
 void AddDocument(SearchServer &ss, int document_id, const std::string_view document, DocumentStatus status,
@@ -138,36 +453,28 @@ void AddDocument(SearchServer &ss, int document_id, const std::string_view docum
 
 template<typename DocumentPredicate>
 std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query,
-                                                     DocumentPredicate document_predicate) const {
-    return FindTopDocuments(std::execution::seq, raw_query, document_predicate);
+                                                     DocumentPredicate document_predicate,
+                                                     size_t k, size_t offset) const {
+    return FindTopDocuments(std::execution::seq, raw_query, document_predicate, k, offset);
 }
 
 template<typename DocumentPredicate, typename ExecutionPolicy>
 std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy policy, const std::string_view raw_query,
-                                                     DocumentPredicate document_predicate) const {
+                                                     DocumentPredicate document_predicate,
+                                                     size_t k, size_t offset) const {
     const auto query = ParseQuery(raw_query);
-    auto matched_documents = FindAllDocuments(policy, query, document_predicate);
-    std::sort(policy, matched_documents.begin(), matched_documents.end(),
-              [](const Document &lhs, const Document &rhs) {
-                  if (std::abs(lhs.relevance - rhs.relevance) < EPSILON) {
-                      return lhs.rating > rhs.rating;
-                  } else {
-                      return lhs.relevance > rhs.relevance;
-                  }
-              });
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
-    }
-    return matched_documents;
+    return FindTopOrdinals(policy, query, BuildExclusionBitmap(query), MakePredicateFilter(document_predicate),
+                           k, offset);
 }
 
 template<typename ExecutionPolicy>
 std::vector<Document>
-SearchServer::FindTopDocuments(ExecutionPolicy policy, const std::string_view raw_query, DocumentStatus status) const {
-    return FindTopDocuments(policy, std::string(raw_query),
-                            [status](int document_id, DocumentStatus document_status, int rating) {
-                                return document_status == status;
-                            });
+SearchServer::FindTopDocuments(ExecutionPolicy policy, const std::string_view raw_query, DocumentStatus status,
+                               size_t k, size_t offset) const {
+    const auto query = ParseQuery(raw_query);
+    return FindCachedTopDocuments(query, status, k, offset, [&] {
+        return FindTopOrdinals(policy, query, BuildExclusionBitmap(query), MakeStatusFilter(status), k, offset);
+    });
 }
 
 template<typename ExecutionPolicy>
@@ -175,45 +482,497 @@ std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy policy, con
     return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
 }
 
+template<typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocuments(const PreparedQuery &prepared_query,
+                                                     DocumentPredicate document_predicate,
+                                                     size_t k, size_t offset) const {
+    return FindTopDocuments(std::execution::seq, prepared_query, document_predicate, k, offset);
+}
 
 template<typename DocumentPredicate, typename ExecutionPolicy>
-std::vector<Document>
-SearchServer::FindAllDocuments(ExecutionPolicy policy, const Query &query, DocumentPredicate document_predicate) const {
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy policy, const PreparedQuery &prepared_query,
+                                                     DocumentPredicate document_predicate,
+                                                     size_t k, size_t offset) const {
+    CheckIsCurrent(prepared_query);
+    return FindTopOrdinals(policy, prepared_query.query_, prepared_query.excluded_,
+                           MakePredicateFilter(document_predicate), k, offset);
+}
 
+template<typename ExecutionPolicy>
+std::vector<Document>
+SearchServer::FindTopDocuments(ExecutionPolicy policy, const PreparedQuery &prepared_query, DocumentStatus status,
+                               size_t k, size_t offset) const {
+    CheckIsCurrent(prepared_query);
+    return FindCachedTopDocuments(prepared_query.query_, status, k, offset, [&] {
+        return FindTopOrdinals(policy, prepared_query.query_, prepared_query.excluded_, MakeStatusFilter(status),
+                               k, offset);
+    });
+}
 
-    ConcurrentMap<int, double> document_to_relevance(50);
+template<typename ExecutionPolicy>
+std::vector<Document>
+SearchServer::FindTopDocuments(ExecutionPolicy policy, const PreparedQuery &prepared_query) const {
+    return FindTopDocuments(policy, prepared_query, DocumentStatus::ACTUAL);
+}
 
+template<typename FindTop>
+std::vector<Document> SearchServer::FindCachedTopDocuments(const Query &query, DocumentStatus status,
+                                                           size_t k, size_t offset,
+                                                           FindTop find_top_documents) const {
+    // the key copies the terms to the heap, so it is only built when the cache is on
+    if (result_cache_.GetCapacity() == 0) {
+        return find_top_documents();
+    }
+    ResultCacheKey key{{query.plus_terms.begin(), query.plus_terms.end()},
+                       {query.minus_terms.begin(), query.minus_terms.end()}, status, k, offset};
+    if (auto cached_documents = result_cache_.Find(key, index_generation_)) {
+        return std::move(*cached_documents);
+    }
+    auto top_documents = find_top_documents();
+    result_cache_.Insert(std::move(key), index_generation_, top_documents);
+    return top_documents;
+}
 
-    std::for_each(policy, query.plus_words.begin(), query.plus_words.end(), [&](auto word) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            return;
+template<typename ExecutionPolicy>
+void SearchServer::RemoveDocuments(ExecutionPolicy policy, const std::vector<int> &document_ids) {
+    for (const int document_id: document_ids) {
+        const auto it = id_to_ordinal_.find(document_id);
+        if (it != id_to_ordinal_.end()) {
+            AddTombstone(it->second);
         }
-        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
+    }
+    if (removal_mode_ == RemovalMode::IMMEDIATE) {
+        PurgeRemovedDocuments(policy);
+    }
+}
 
-        for (const auto [document_id, term_freq]: word_to_document_freqs_.at(word)) {
-            const auto &document_data = documents_.at(document_id);
-            if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                document_to_relevance[document_id].ref_to_value += (term_freq * inverse_document_freq);
-            }
+template<typename ExecutionPolicy>
+void SearchServer::PurgeRemovedDocuments(ExecutionPolicy policy) {
+    if (tombstone_count_ == 0) {
+        return;
+    }
+    std::vector<DocumentOrdinal> ordinals;
+    ordinals.reserve(tombstone_count_);
+    for (DocumentOrdinal ordinal = 0; ordinal < documents_.size(); ++ordinal) {
+        if (tombstones_.Test(ordinal)) {
+            ordinals.push_back(ordinal);
         }
+    }
+
+    // every posting list that holds a tombstoned document is swept once
+    std::vector<TermId> term_ids;
+    for (const DocumentOrdinal ordinal: ordinals) {
+        const auto &document_term_ids = documents_[ordinal].term_ids;
+        term_ids.insert(term_ids.end(), document_term_ids.begin(), document_term_ids.end());
+        documents_[ordinal] = DocumentData{};
+    }
+    std::sort(policy, term_ids.begin(), term_ids.end());
+    term_ids.erase(std::unique(term_ids.begin(), term_ids.end()), term_ids.end());
+    std::for_each(policy, term_ids.begin(), term_ids.end(), [this](TermId term_id) {
+        term_postings_[term_id].Remove(tombstones_);
+        tombstoned_postings_[term_id] = 0;
+    });
 
+    tombstones_.Clear();
+    tombstone_count_ = 0;
+    PurgeRemovedIds();
+    FinishRemoval();
+}
 
+template<typename ExecutionPolicy>
+std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>>
+SearchServer::MatchDocuments(ExecutionPolicy policy, const std::string_view raw_query,
+                             const std::vector<int> &document_ids) const {
+    const auto query = ParseQuery(raw_query);
+    std::vector<DocumentOrdinal> ordinals(document_ids.size());
+    std::transform(document_ids.begin(), document_ids.end(), ordinals.begin(), [this](int document_id) {
+        return GetOrdinal(document_id);
     });
 
-    std::for_each(policy, query.minus_words.begin(), query.minus_words.end(), [&](auto &word) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            return;
+    // Walking the posting lists of the minus words once pays off when they are short next
+    // to a forward index search per document and minus word
+    size_t minus_posting_count = 0;
+    for (const TermId term_id: query.minus_terms) {
+        minus_posting_count += term_postings_[term_id].size();
+    }
+    const bool use_exclusion_bitmap = !query.minus_terms.empty()
+                                      && minus_posting_count < ordinals.size() * query.minus_terms.size() * 16;
+    const DocumentBitmap excluded = use_exclusion_bitmap ? BuildExclusionBitmap(query) : DocumentBitmap();
+
+    std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> matched_documents(ordinals.size());
+    std::transform(policy, ordinals.begin(), ordinals.end(), matched_documents.begin(),
+                   [&](DocumentOrdinal ordinal) {
+                       const auto status = static_cast<DocumentStatus>(statuses_[ordinal]);
+                       const bool has_minus_word = use_exclusion_bitmap ? excluded.Test(ordinal)
+                                                                        : HasMinusWord(ordinal, query);
+                       if (has_minus_word) {
+                           return std::tuple{std::vector<std::string_view>(), status};
+                       }
+                       return std::tuple{GetMatchedWords(ordinal, query), status};
+                   });
+    return matched_documents;
+}
+
+template<typename OrdinalFilter, typename ExecutionPolicy>
+std::vector<Document> SearchServer::FindTopOrdinals(ExecutionPolicy policy, const Query &query,
+                                                    const DocumentBitmap &excluded, OrdinalFilter ordinal_filter,
+                                                    size_t k, size_t offset) const {
+    // the best offset + k documents are selected, and the first offset of them are dropped
+    const size_t document_count = k < std::numeric_limits<size_t>::max() - offset
+                                  ? offset + k : std::numeric_limits<size_t>::max();
+    auto top_documents = [&] {
+        if (query_evaluation_ == QueryEvaluation::IMPACT_ORDERED && impact_index_) {
+            return FindTopDocumentsByImpact(*impact_index_, query, excluded, ordinal_filter, document_count);
+        }
+        if (query_evaluation_ != QueryEvaluation::EXHAUSTIVE) {
+            if constexpr (std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::sequenced_policy>) {
+                return FindTopDocumentsPruned(query, excluded, ordinal_filter, document_count,
+                                              0, static_cast<DocumentOrdinal>(documents_.size()));
+            } else {
+                return FindTopDocumentsPartitioned(policy, query, excluded, ordinal_filter, document_count);
+            }
         }
-        for (const auto [document_id, _]: word_to_document_freqs_.at(word)) {
-            document_to_relevance.Erase(document_id);
+        auto matched_documents = FindAllDocuments(policy, query, excluded, ordinal_filter);
+        const auto top_end = matched_documents.begin() + std::min(document_count, matched_documents.size());
+        std::partial_sort(policy, matched_documents.begin(), top_end, matched_documents.end(), IsRankedHigher);
+        matched_documents.erase(top_end, matched_documents.end());
+        return matched_documents;
+    }();
+    top_documents.erase(top_documents.begin(), top_documents.begin() + std::min(offset, top_documents.size()));
+    return top_documents;
+}
+
+
+template<typename OrdinalFilter, typename ExecutionPolicy>
+std::vector<Document>
+SearchServer::FindAllDocuments(ExecutionPolicy policy, const Query &query, const DocumentBitmap &excluded,
+                               OrdinalFilter ordinal_filter) const {
+    // every group of consecutive plus words gets its own accumulator, so the posting loop takes no locks;
+    // the groups are summed in word order afterwards
+    const size_t plus_count = query.plus_terms.size();
+    const size_t group_count = std::min<size_t>(plus_count, std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<std::unique_ptr<ScoreAccumulator>> accumulators(group_count);
+    std::vector<size_t> groups(group_count);
+    std::iota(groups.begin(), groups.end(), 0);
+    const bool has_exclusions = !excluded.empty();
+    std::for_each(policy, groups.begin(), groups.end(), [&](size_t group) {
+        auto accumulator = accumulator_pool_.Acquire(documents_.size());
+        for (size_t i = group * plus_count / group_count; i < (group + 1) * plus_count / group_count; ++i) {
+            const TermId term_id = query.plus_terms[i];
+            const double inverse_document_freq = ComputeWordInverseDocumentFreq(term_id);
+            term_postings_[term_id].ForEach([&](DocumentOrdinal ordinal, double term_freq) {
+                if (!(has_exclusions && excluded.Test(ordinal)) && ordinal_filter(ordinal)) {
+                    accumulator->Add(ordinal, term_freq * inverse_document_freq);
+                }
+            });
         }
+        accumulators[group] = std::move(accumulator);
+    });
 
+    std::vector<Document> matched_documents;
+    if (accumulators.empty()) {
+        return matched_documents;
+    }
+    for (size_t group = 1; group < group_count; ++group) {
+        accumulators.front()->Merge(*accumulators[group]);
+        accumulator_pool_.Release(std::move(accumulators[group]));
+    }
+    accumulators.front()->ForEach([&](DocumentOrdinal ordinal, double relevance) {
+        matched_documents.emplace_back(ordinal_to_id_[ordinal], relevance, ratings_[ordinal]);
     });
+    accumulator_pool_.Release(std::move(accumulators.front()));
+    return matched_documents;
+}
 
+// Document-at-a-time merge of the plus-word posting lists: every document is scored once,
+// in ascending ordinal order, without intermediate maps
+template<typename OrdinalFilter>
+std::vector<Document>
+SearchServer::FindAllDocuments(std::execution::sequenced_policy, const Query &query,
+                               const DocumentBitmap &excluded, OrdinalFilter ordinal_filter) const {
+    struct Cursor {
+        PostingCursor postings;
+        double inverse_document_freq;
+        size_t word_index;
+    };
+
+    std::vector<Cursor> plus_cursors;
+    plus_cursors.reserve(query.plus_terms.size());
+    for (const TermId term_id: query.plus_terms) {
+        const auto &postings = term_postings_[term_id];
+        if (!postings.empty()) {
+            plus_cursors.push_back({PostingCursor(postings), ComputeWordInverseDocumentFreq(term_id),
+                                    plus_cursors.size()});
+        }
+    }
+
+    // Min-heap by ordinal; equal ordinals are popped in query word order
+    const auto is_later = [](const Cursor &lhs, const Cursor &rhs) {
+        if (lhs.postings.GetOrdinal() != rhs.postings.GetOrdinal()) {
+            return lhs.postings.GetOrdinal() > rhs.postings.GetOrdinal();
+        }
+        return lhs.word_index > rhs.word_index;
+    };
+    std::make_heap(plus_cursors.begin(), plus_cursors.end(), is_later);
+
+    const bool has_exclusions = !excluded.empty();
     std::vector<Document> matched_documents;
-    for (const auto [document_id, relevance]: document_to_relevance.BuildOrdinaryMap()) {
-        matched_documents.emplace_back(document_id, relevance, documents_.at(document_id).rating);
+    while (!plus_cursors.empty()) {
+        const DocumentOrdinal ordinal = plus_cursors.front().postings.GetOrdinal();
+        const bool is_matched = !(has_exclusions && excluded.Test(ordinal)) && ordinal_filter(ordinal);
+        double relevance = 0.0;
+        while (!plus_cursors.empty() && plus_cursors.front().postings.GetOrdinal() == ordinal) {
+            std::pop_heap(plus_cursors.begin(), plus_cursors.end(), is_later);
+            auto &cursor = plus_cursors.back();
+            if (is_matched) {
+                relevance += cursor.postings.GetTermFreq() * cursor.inverse_document_freq;
+            }
+            cursor.postings.Next();
+            if (cursor.postings.AtEnd()) {
+                plus_cursors.pop_back();
+            } else {
+                std::push_heap(plus_cursors.begin(), plus_cursors.end(), is_later);
+            }
+        }
+
+        if (is_matched) {
+            matched_documents.emplace_back(ordinal_to_id_[ordinal], relevance, ratings_[ordinal]);
+        }
     }
     return matched_documents;
 }
 
+// Block-max MaxScore over windows of ordinals. In each window the words are ordered by their block
+// max score; the longest prefix whose bounds can't reach the top together is non-essential. The
+// essential words are scored into a dense window buffer, and the non-essential ones are only
+// probed for documents that can still get into the top
+template<typename OrdinalFilter>
+std::vector<Document>
+SearchServer::FindTopDocumentsPruned(const Query &query, const DocumentBitmap &excluded,
+                                     OrdinalFilter ordinal_filter, size_t document_count,
+                                     DocumentOrdinal first_ordinal, DocumentOrdinal end_ordinal) const {
+    constexpr size_t WINDOW_SIZE = 1024;
+    const bool has_exclusions = !excluded.empty();
+
+    struct Cursor {
+        PostingCursor postings;
+        double inverse_document_freq;
+        double max_score;
+    };
+
+    std::vector<Cursor> cursors;
+    cursors.reserve(query.plus_terms.size());
+    for (const TermId term_id: query.plus_terms) {
+        const auto &postings = term_postings_[term_id];
+        if (!postings.empty()) {
+            cursors.push_back({PostingCursor(postings), ComputeWordInverseDocumentFreq(term_id), 0.0});
+            cursors.back().postings.SkipTo(first_ordinal);
+        }
+    }
+
+    TopDocuments top_documents(document_count);
+    std::vector<Cursor *> order;
+    order.reserve(cursors.size());
+    std::vector<double> scores(WINDOW_SIZE);
+    std::array<uint64_t, WINDOW_SIZE / 64> matched{};
+    while (true) {
+        DocumentOrdinal window_begin = end_ordinal;
+        for (const auto &cursor: cursors) {
+            if (!cursor.postings.AtEnd()) {
+                window_begin = std::min(window_begin, cursor.postings.GetOrdinal());
+            }
+        }
+        if (window_begin == end_ordinal) {
+            break;
+        }
+        const DocumentOrdinal window_end = window_begin + static_cast<DocumentOrdinal>(
+                std::min<size_t>(WINDOW_SIZE, end_ordinal - window_begin));
+
+        order.clear();
+        for (auto &cursor: cursors) {
+            if (!cursor.postings.AtEnd()) {
+                cursor.max_score = cursor.inverse_document_freq
+                                   * cursor.postings.GetMaxTermFreq(window_begin, window_end - 1);
+                order.push_back(&cursor);
+            }
+        }
+        std::sort(order.begin(), order.end(), [](const Cursor *lhs, const Cursor *rhs) {
+            return lhs->max_score < rhs->max_score;
+        });
+        size_t essential_begin = 0;
+        double non_essential_bound = 0.0;
+        while (essential_begin < order.size()
+               && !top_documents.CanEnter(non_essential_bound + order[essential_begin]->max_score)) {
+            non_essential_bound += order[essential_begin++]->max_score;
+        }
+
+        for (size_t i = essential_begin; i < order.size(); ++i) {
+            auto &postings = order[i]->postings;
+            for (; !postings.AtEnd() && postings.GetOrdinal() < window_end; postings.Next()) {
+                if (has_exclusions && excluded.Test(postings.GetOrdinal())) {
+                    continue;
+                }
+                const size_t offset = postings.GetOrdinal() - window_begin;
+                scores[offset] += postings.GetTermFreq() * order[i]->inverse_document_freq;
+                matched[offset / 64] |= uint64_t{1} << offset % 64;
+            }
+        }
+
+        for (size_t word = 0; word < matched.size(); ++word) {
+            for (; matched[word] != 0; matched[word] &= matched[word] - 1) {
+                const size_t offset = word * 64 + __builtin_ctzll(matched[word]);
+                const DocumentOrdinal ordinal = window_begin + static_cast<DocumentOrdinal>(offset);
+                double relevance = std::exchange(scores[offset], 0.0);
+                double bound = relevance + non_essential_bound;
+                // the strongest non-essential words first, so a hopeless document is dropped early
+                for (size_t i = essential_begin; i > 0 && top_documents.CanEnter(bound); --i) {
+                    auto &postings = order[i - 1]->postings;
+                    bound -= order[i - 1]->max_score;
+                    postings.SkipTo(ordinal);
+                    if (!postings.AtEnd() && postings.GetOrdinal() == ordinal) {
+                        const double score = postings.GetTermFreq() * order[i - 1]->inverse_document_freq;
+                        relevance += score;
+                        bound += score;
+                    }
+                }
+                if (top_documents.CanEnter(bound) && ordinal_filter(ordinal)) {
+                    top_documents.Add({ordinal_to_id_[ordinal], relevance, ratings_[ordinal]});
+                }
+            }
+        }
+
+        for (size_t i = 0; i < essential_begin; ++i) {
+            order[i]->postings.SkipTo(window_end);
+        }
+    }
+    return top_documents.Extract();
+}
+
+// Ranges of consecutive ordinals are evaluated independently, so a short query still keeps every
+// core busy and no two threads touch the same document. Each range keeps its own top, and the
+// tops are merged at the end
+template<typename OrdinalFilter, typename ExecutionPolicy>
+std::vector<Document>
+SearchServer::FindTopDocumentsPartitioned(ExecutionPolicy policy, const Query &query, const DocumentBitmap &excluded,
+                                          OrdinalFilter ordinal_filter, size_t document_count) const {
+    // smaller ranges cost more in cursor setup than they gain in parallelism
+    constexpr size_t MIN_RANGE_SIZE = 2048;
+
+    const size_t ordinal_count = documents_.size();
+    const size_t range_count = std::clamp<size_t>(ordinal_count / MIN_RANGE_SIZE, 1,
+                                                  std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<std::vector<Document>> range_tops(range_count);
+    std::vector<size_t> ranges(range_count);
+    std::iota(ranges.begin(), ranges.end(), 0);
+    std::for_each(policy, ranges.begin(), ranges.end(), [&](size_t range) {
+        range_tops[range] = FindTopDocumentsPruned(
+                query, excluded, ordinal_filter, document_count,
+                static_cast<DocumentOrdinal>(range * ordinal_count / range_count),
+                static_cast<DocumentOrdinal>((range + 1) * ordinal_count / range_count));
+    });
+
+    TopDocuments top_documents(document_count);
+    for (const auto &range_top: range_tops) {
+        for (const Document &document: range_top) {
+            top_documents.Add(document);
+        }
+    }
+    return top_documents.Extract();
+}
+
+// Segments are taken across all plus words in descending impact order, and their impacts are added
+// to per-document sums. Every so often the documents with the highest sums are scored exactly to
+// get a threshold; once the impacts left in all lists together can't reach it, no unseen document
+// can get into the top. The seen documents whose sum plus the remaining impacts can still reach it
+// are then scored exactly
+template<typename OrdinalFilter>
+std::vector<Document>
+SearchServer::FindTopDocumentsByImpact(const ImpactIndex &impact_index, const Query &query,
+                                       const DocumentBitmap &excluded, OrdinalFilter ordinal_filter,
+                                       size_t document_count) const {
+    constexpr size_t MIN_POSTINGS_BETWEEN_CHECKS = 64;
+    constexpr size_t MAX_OPEN_CANDIDATES = 64;
+    const bool has_exclusions = !excluded.empty();
+
+    struct TermSegments {
+        const ImpactSegment *next;
+        const ImpactSegment *end;
+        const DocumentOrdinal *ordinals;
+    };
+
+    std::vector<TermSegments> terms;
+    // Sum of the next impact of every list: the most an unseen document can still get
+    uint64_t remaining_impact = 0;
+    for (const TermId term_id: query.plus_terms) {
+        const auto &segments = impact_index.GetSegments(term_id);
+        if (!segments.empty()) {
+            terms.push_back({segments.data(), segments.data() + segments.size(), impact_index.GetOrdinals(term_id)});
+            remaining_impact += segments.front().impact;
+        }
+    }
+    const auto has_lower_impact = [](const TermSegments &lhs, const TermSegments &rhs) {
+        return lhs.next->impact < rhs.next->impact;
+    };
+    std::make_heap(terms.begin(), terms.end(), has_lower_impact);
+
+    auto accumulator = accumulator_pool_.Acquire(documents_.size());
+    const double impact_step = impact_index.GetImpactStep();
+    std::vector<std::pair<double, DocumentOrdinal>> candidates;
+    TopDocuments top_documents(document_count);
+    size_t postings_since_check = 0;
+    while (true) {
+        if (terms.empty() || postings_since_check >= std::max(MIN_POSTINGS_BETWEEN_CHECKS, accumulator->size())) {
+            postings_since_check = 0;
+            candidates.clear();
+            accumulator->ForEach([&candidates](DocumentOrdinal ordinal, double impact_sum) {
+                candidates.emplace_back(impact_sum, ordinal);
+            });
+            const auto top_end = candidates.begin() + std::min(document_count, candidates.size());
+            std::nth_element(candidates.begin(), top_end, candidates.end(), std::greater<>());
+            top_documents = TopDocuments(document_count);
+            for (auto it = candidates.begin(); it != top_end; ++it) {
+                top_documents.Add({ordinal_to_id_[it->second], ComputeRelevance(it->second, query),
+                                   ratings_[it->second]});
+            }
+            candidates.erase(candidates.begin(), top_end);
+            if (terms.empty()) {
+                break;
+            }
+            // exact scoring costs far more than adding impacts, so stop only once few documents are left open
+            const auto is_open = [&](const auto &candidate) {
+                return top_documents.CanEnter((candidate.first + static_cast<double>(remaining_impact)) * impact_step);
+            };
+            if (!top_documents.CanEnter(static_cast<double>(remaining_impact) * impact_step)
+                && static_cast<size_t>(std::count_if(candidates.begin(), candidates.end(), is_open))
+                   <= MAX_OPEN_CANDIDATES) {
+                break;
+            }
+        }
+
+        std::pop_heap(terms.begin(), terms.end(), has_lower_impact);
+        auto &term = terms.back();
+        const ImpactSegment segment = *term.next++;
+        remaining_impact -= segment.impact;
+        for (uint32_t i = segment.begin; i < segment.end; ++i) {
+            const DocumentOrdinal ordinal = term.ordinals[i];
+            if (!(has_exclusions && excluded.Test(ordinal)) && ordinal_filter(ordinal)) {
+                accumulator->Add(ordinal, segment.impact);
+            }
+        }
+        postings_since_check += segment.end - segment.begin;
+        if (term.next == term.end) {
+            terms.pop_back();
+        } else {
+            remaining_impact += term.next->impact;
+            std::push_heap(terms.begin(), terms.end(), has_lower_impact);
+        }
+    }
+
+    for (const auto &[impact_sum, ordinal]: candidates) {
+        if (top_documents.CanEnter((impact_sum + static_cast<double>(remaining_impact)) * impact_step)) {
+            top_documents.Add({ordinal_to_id_[ordinal], ComputeRelevance(ordinal, query), ratings_[ordinal]});
+        }
+    }
+    accumulator_pool_.Release(std::move(accumulator));
+    return top_documents.Extract();
+}
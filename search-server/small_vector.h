@@ -0,0 +1,129 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+
+// A vector of trivially copyable values that keeps the first N of them inline and
+// moves to the heap only once they no longer fit
+template<typename T, std::size_t N>
+class SmallVector {
+    static_assert(std::is_trivially_copyable_v<T>, "SmallVector copies its elements bytewise");
+
+public:
+    SmallVector() = default;
+
+    SmallVector(const SmallVector &other) {
+        Assign(other);
+    }
+
+    SmallVector(SmallVector &&other) noexcept {
+        Steal(other);
+    }
+
+    SmallVector &operator=(const SmallVector &other) {
+        if (this != &other) {
+            size_ = 0;
+            Assign(other);
+        }
+        return *this;
+    }
+
+    SmallVector &operator=(SmallVector &&other) noexcept {
+        if (this != &other) {
+            heap_.reset();
+            data_ = inline_;
+            capacity_ = N;
+            Steal(other);
+        }
+        return *this;
+    }
+
+    void push_back(const T &value) {
+        if (size_ == capacity_) {
+            reserve(capacity_ * 2);
+        }
+        data_[size_++] = value;
+    }
+
+    void reserve(std::size_t capacity) {
+        if (capacity <= capacity_) {
+            return;
+        }
+        auto heap = std::make_unique<T[]>(capacity);
+        std::copy(data_, data_ + size_, heap.get());
+        heap_ = std::move(heap);
+        data_ = heap_.get();
+        capacity_ = capacity;
+    }
+
+    void erase(T *first, T *last) {
+        size_ = std::copy(last, end(), first) - data_;
+    }
+
+    void clear() {
+        size_ = 0;
+    }
+
+    T *begin() {
+        return data_;
+    }
+
+    T *end() {
+        return data_ + size_;
+    }
+
+    const T *begin() const {
+        return data_;
+    }
+
+    const T *end() const {
+        return data_ + size_;
+    }
+
+    T &operator[](std::size_t index) {
+        return data_[index];
+    }
+
+    const T &operator[](std::size_t index) const {
+        return data_[index];
+    }
+
+    std::size_t size() const {
+        return size_;
+    }
+
+    bool empty() const {
+        return size_ == 0;
+    }
+
+private:
+    T inline_[N];
+    std::unique_ptr<T[]> heap_;
+    T *data_ = inline_;
+    std::size_t size_ = 0;
+    std::size_t capacity_ = N;
+
+    void Assign(const SmallVector &other) {
+        reserve(other.size_);
+        std::copy(other.begin(), other.end(), data_);
+        size_ = other.size_;
+    }
+
+    // Takes the heap buffer of other, or copies its inline elements
+    void Steal(SmallVector &other) {
+        if (other.heap_) {
+            heap_ = std::move(other.heap_);
+            data_ = heap_.get();
+            capacity_ = other.capacity_;
+            size_ = other.size_;
+            other.data_ = other.inline_;
+            other.capacity_ = N;
+            other.size_ = 0;
+        } else {
+            Assign(other);
+            other.size_ = 0;
+        }
+    }
+};
@@ -0,0 +1,122 @@
+#include "stop_word_set.h"
+
+#include <algorithm>
+#include <numeric>
+
+#include "hash_mix.h"
+
+using namespace std;
+
+namespace {
+
+size_t CeilPowerOfTwo(size_t value) {
+    size_t power = 1;
+    while (power < value) {
+        power *= 2;
+    }
+    return power;
+}
+
+}
+
+StopWordSet::StopWordSet() : StopWordSet(set<string>()) {
+}
+
+StopWordSet::StopWordSet(const set<string> &words) : words_(words.begin(), words.end()) {
+    // 16 filter bits per word keep the false positive rate near 1.5%
+    const size_t filter_size = max<size_t>(64, CeilPowerOfTwo(words_.size() * 16));
+    filter_.assign(filter_size / 64, 0);
+    while ((size_t{1} << filter_bits_) < filter_size) {
+        ++filter_bits_;
+    }
+    for (const string &word: words_) {
+        if (word.empty()) {
+            continue;
+        }
+        const uint64_t key = GetFilterKey(word);
+        for (const uint64_t bit: {key >> (64 - filter_bits_),
+                                  (key >> (64 - 2 * filter_bits_)) & ((uint64_t{1} << filter_bits_) - 1)}) {
+            filter_[bit / 64] |= uint64_t{1} << (bit % 64);
+        }
+    }
+
+    // Hash and displace: buckets of about two words are placed biggest first, each with the
+    // first displacement that sends all its words to free slots
+    slots_.resize(CeilPowerOfTwo(words_.size() + words_.size() / 4 + 1));
+    displacements_.assign(CeilPowerOfTwo(words_.size() / 2 + 1), 0);
+    vector<uint64_t> hashes(words_.size());
+    vector<vector<uint32_t>> buckets(displacements_.size());
+    for (seed_ = 0;; ++seed_) {
+        for (auto &bucket: buckets) {
+            bucket.clear();
+        }
+        for (uint32_t word = 0; word < words_.size(); ++word) {
+            hashes[word] = Hash(words_[word], seed_);
+            buckets[(hashes[word] >> 32) & (displacements_.size() - 1)].push_back(word);
+        }
+        if (TryPlace(buckets, hashes)) {
+            break;
+        }
+    }
+}
+
+bool StopWordSet::TryPlace(const vector<vector<uint32_t>> &buckets, const vector<uint64_t> &hashes) {
+    constexpr uint32_t MAX_DISPLACEMENT = 1 << 16;
+
+    fill(slots_.begin(), slots_.end(), Slot{});
+    vector<size_t> order(buckets.size());
+    iota(order.begin(), order.end(), 0);
+    stable_sort(order.begin(), order.end(), [&buckets](size_t lhs, size_t rhs) {
+        return buckets[lhs].size() > buckets[rhs].size();
+    });
+
+    vector<size_t> bucket_slots;
+    for (const size_t bucket: order) {
+        if (buckets[bucket].empty()) {
+            break;
+        }
+        bool is_placed = false;
+        for (uint32_t displacement = 0; !is_placed && displacement < MAX_DISPLACEMENT; ++displacement) {
+            displacements_[bucket] = displacement;
+            bucket_slots.clear();
+            is_placed = all_of(buckets[bucket].begin(), buckets[bucket].end(), [&](uint32_t word) {
+                const size_t slot = GetSlot(hashes[word]);
+                if (slots_[slot].word != NO_WORD
+                    || find(bucket_slots.begin(), bucket_slots.end(), slot) != bucket_slots.end()) {
+                    return false;
+                }
+                bucket_slots.push_back(slot);
+                return true;
+            });
+        }
+        if (!is_placed) {
+            return false;
+        }
+        for (size_t i = 0; i < bucket_slots.size(); ++i) {
+            const uint32_t word = buckets[bucket][i];
+            slots_[bucket_slots[i]] = {hashes[word], word};
+        }
+    }
+    return true;
+}
+
+bool StopWordSet::ContainsHashed(string_view word) const {
+    const uint64_t hash = Hash(word, seed_);
+    const Slot &slot = slots_[GetSlot(hash)];
+    return slot.hash == hash && slot.word != NO_WORD && words_[slot.word] == word;
+}
+
+uint64_t StopWordSet::Hash(string_view word, uint64_t seed) {
+    // FNV-1a, mixed so that both halves of the hash are usable
+    uint64_t hash = 14695981039346656037ull ^ MixBits(seed);
+    for (const char c: word) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ull;
+    }
+    return MixBits(hash);
+}
+
+size_t StopWordSet::GetSlot(uint64_t hash) const {
+    const uint32_t displacement = displacements_[(hash >> 32) & (displacements_.size() - 1)];
+    return MixBits(hash + displacement * 0x9e3779b97f4a7c15ULL) & (slots_.size() - 1);
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Immutable set of stop words. A Bloom filter keyed by the length and three bytes of a word
+// turns most other words away in a few instructions; the rest are hashed once into a
+// perfect hash table, where the only candidate slot is compared with the word
+class StopWordSet {
+public:
+    StopWordSet();
+
+    explicit StopWordSet(const std::set<std::string> &words);
+
+    bool Contains(std::string_view word) const {
+        return !word.empty() && MayContain(word) && ContainsHashed(word);
+    }
+
+    std::size_t size() const {
+        return words_.size();
+    }
+
+private:
+    static constexpr uint32_t NO_WORD = UINT32_MAX;
+
+    struct Slot {
+        uint64_t hash = 0;
+        uint32_t word = NO_WORD;
+    };
+
+    std::vector<std::string> words_;
+    // Two bits per word
+    std::vector<uint64_t> filter_;
+    int filter_bits_ = 0;
+    uint64_t seed_ = 0;
+    // Indexed by the high half of the hash; picks where the words of a bucket go
+    std::vector<uint32_t> displacements_;
+    std::vector<Slot> slots_;
+
+    static uint64_t GetFilterKey(std::string_view word) {
+        const uint64_t key = word.size() << 24
+                             | uint64_t{static_cast<unsigned char>(word.front())} << 16
+                             | uint64_t{static_cast<unsigned char>(word[word.size() / 2])} << 8
+                             | static_cast<unsigned char>(word.back());
+        return key * 0x9e3779b97f4a7c15ULL;
+    }
+
+    bool TestFilterBit(uint64_t bit) const {
+        return (filter_[bit / 64] >> (bit % 64)) & 1;
+    }
+
+    bool MayContain(std::string_view word) const {
+        const uint64_t key = GetFilterKey(word);
+        return TestFilterBit(key >> (64 - filter_bits_))
+               && TestFilterBit((key >> (64 - 2 * filter_bits_)) & ((uint64_t{1} << filter_bits_) - 1));
+    }
+
+    bool ContainsHashed(std::string_view word) const;
+
+    static uint64_t Hash(std::string_view word, uint64_t seed);
+
+    std::size_t GetSlot(uint64_t hash) const;
+
+    bool TryPlace(const std::vector<std::vector<uint32_t>> &buckets, const std::vector<uint64_t> &hashes);
+};
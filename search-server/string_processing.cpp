@@ -1,24 +1,104 @@
 #include "string_processing.h"
-std::vector<std::string_view> SplitIntoWords(const std::string_view & text) {
-  std::vector<std::string_view> words;
-  auto pointer = &text[0];
-  int length = 0;
-  for (const char& c : text) {
-    if (c == ' ') {
-      if (length != 0) {
-        words.emplace_back(pointer, length);
-        length = 0;
-      }
-    } else {
-        if (length == 0) {
-            pointer = &c;
-        }
-      length += 1;
-    }
+
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SEARCH_SERVER_X86_SIMD
+#endif
+
+namespace {
+
+struct ChunkBits {
+  uint64_t spaces;
+  uint64_t controls;
+};
+
+// Control characters are the bytes below ' '
+ChunkBits ScanChunkScalar(const char* chunk) {
+  ChunkBits bits{0, 0};
+  for (int i = 0; i < 64; ++i) {
+    const auto c = static_cast<unsigned char>(chunk[i]);
+    bits.spaces |= uint64_t{c == ' '} << i;
+    bits.controls |= uint64_t{c < ' '} << i;
+  }
+  return bits;
+}
+
+#ifdef SEARCH_SERVER_X86_SIMD
+
+__attribute__((target("sse2"))) ChunkBits ScanChunkSse2(const char* chunk) {
+  const __m128i spaces = _mm_set1_epi8(' ');
+  const __m128i last_control = _mm_set1_epi8(' ' - 1);
+  ChunkBits bits{0, 0};
+  for (int i = 0; i < 4; ++i) {
+    const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(chunk + 16 * i));
+    const auto space_mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, spaces)));
+    // unsigned byte <= 31 exactly when min(byte, 31) == byte
+    const auto control_mask = static_cast<uint32_t>(
+        _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(bytes, last_control), bytes)));
+    bits.spaces |= uint64_t{space_mask} << (16 * i);
+    bits.controls |= uint64_t{control_mask} << (16 * i);
+  }
+  return bits;
+}
+
+__attribute__((target("avx2"))) ChunkBits ScanChunkAvx2(const char* chunk) {
+  const __m256i spaces = _mm256_set1_epi8(' ');
+  const __m256i last_control = _mm256_set1_epi8(' ' - 1);
+  ChunkBits bits{0, 0};
+  for (int i = 0; i < 2; ++i) {
+    const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(chunk + 32 * i));
+    const auto space_mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, spaces)));
+    const auto control_mask = static_cast<uint32_t>(
+        _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_min_epu8(bytes, last_control), bytes)));
+    bits.spaces |= uint64_t{space_mask} << (32 * i);
+    bits.controls |= uint64_t{control_mask} << (32 * i);
   }
-  if (length != 0) {
-    words.emplace_back(pointer, length);
+  return bits;
+}
+
+#endif
+
+using ScanChunkFunction = ChunkBits (*)(const char*);
+
+// Picked once, on first use, for the CPU we run on
+ScanChunkFunction SelectScanChunk() {
+#ifdef SEARCH_SERVER_X86_SIMD
+  if (__builtin_cpu_supports("avx2")) {
+    return ScanChunkAvx2;
+  }
+  if (__builtin_cpu_supports("sse2")) {
+    return ScanChunkSse2;
+  }
+#endif
+  return ScanChunkScalar;
+}
+
+}
+
+void WordScanner::LoadChunk(std::size_t chunk_begin) {
+  chunk_begin_ = chunk_begin;
+  position_ = chunk_begin;
+  static const ScanChunkFunction scan_chunk = SelectScanChunk();
+  ChunkBits bits;
+  if (chunk_begin + CHUNK_SIZE <= text_.size()) {
+    bits = scan_chunk(text_.data() + chunk_begin);
+  } else {
+    // the tail is padded with separators
+    char chunk[CHUNK_SIZE];
+    const std::size_t size = text_.size() - std::min(chunk_begin, text_.size());
+    std::fill(std::copy_n(text_.data() + chunk_begin, size, chunk), chunk + CHUNK_SIZE, ' ');
+    bits = scan_chunk(chunk);
   }
+  spaces_ = bits.spaces;
+  controls_ = bits.controls;
+}
 
+std::vector<std::string_view> SplitIntoWords(const std::string_view & text) {
+  std::vector<std::string_view> words;
+  for (const Token& token : SplitIntoTokens(text)) {
+    words.push_back(token.word);
+  }
   return words;
 }
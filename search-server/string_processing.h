@@ -1,7 +1,146 @@
 #pragma once
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
 #include <vector>
 #include <set>
 #include <string>
+#include <string_view>
+
+struct Token {
+  std::string_view word;
+  // False if the word has a control character
+  bool is_valid = true;
+};
+
+// Finds the space separated words of a text 64 bytes at a time. Every chunk is scanned once,
+// with SSE2 or AVX2 where the CPU has them, for both separators and control characters,
+// so the words come out already validated
+class WordScanner {
+ public:
+  WordScanner() = default;
+
+  explicit WordScanner(const std::string_view text) : text_(text) {
+    LoadChunk(0);
+  }
+
+  // False at the end of the text
+  bool Next(Token& token) {
+    // skip the separators
+    uint64_t word_bits;
+    while ((word_bits = ~spaces_ & BitsFrom(position_ - chunk_begin_)) == 0) {
+      if (chunk_begin_ + CHUNK_SIZE >= text_.size()) {
+        return false;
+      }
+      LoadChunk(chunk_begin_ + CHUNK_SIZE);
+    }
+    const std::size_t word_begin = chunk_begin_ + __builtin_ctzll(word_bits);
+    position_ = word_begin;
+    // bytes past the end of the text read as separators, so every word ends in some chunk
+    uint64_t control_bits = 0;
+    uint64_t separator_bits;
+    while ((separator_bits = spaces_ & BitsFrom(position_ - chunk_begin_)) == 0) {
+      control_bits |= controls_ & BitsFrom(position_ - chunk_begin_);
+      LoadChunk(chunk_begin_ + CHUNK_SIZE);
+    }
+    const std::size_t word_end = chunk_begin_ + __builtin_ctzll(separator_bits);
+    control_bits |= controls_ & BitsFrom(position_ - chunk_begin_) & ~BitsFrom(word_end - chunk_begin_);
+    position_ = word_end;
+    token.word = text_.substr(word_begin, word_end - word_begin);
+    token.is_valid = control_bits == 0;
+    return true;
+  }
+
+ private:
+  static constexpr std::size_t CHUNK_SIZE = 64;
+
+  std::string_view text_;
+  std::size_t chunk_begin_ = 0;
+  // Scan position inside the current chunk
+  std::size_t position_ = 0;
+  // Bit i describes the byte chunk_begin_ + i
+  uint64_t spaces_ = 0;
+  uint64_t controls_ = 0;
+
+  // Scans the chunk at chunk_begin and moves the position to its start
+  void LoadChunk(std::size_t chunk_begin);
+
+  // Bits index and up; index is below CHUNK_SIZE
+  static uint64_t BitsFrom(std::size_t index) {
+    return ~uint64_t{0} << index;
+  }
+};
+
+// Forward iterator over the words of a text; each word is found when the iterator reaches it
+class TokenIterator {
+ public:
+  using iterator_category = std::forward_iterator_tag;
+  using value_type = Token;
+  using difference_type = std::ptrdiff_t;
+  using pointer = const Token*;
+  using reference = const Token&;
+
+  // The end iterator
+  TokenIterator() = default;
+
+  explicit TokenIterator(const std::string_view text) : scanner_(text), is_end_(false) {
+    ++*this;
+  }
+
+  reference operator*() const {
+    return token_;
+  }
+
+  pointer operator->() const {
+    return &token_;
+  }
+
+  TokenIterator& operator++() {
+    is_end_ = !scanner_.Next(token_);
+    return *this;
+  }
+
+  TokenIterator operator++(int) {
+    TokenIterator previous = *this;
+    ++*this;
+    return previous;
+  }
+
+  bool operator==(const TokenIterator& other) const {
+    return is_end_ == other.is_end_ && (is_end_ || token_.word.data() == other.token_.word.data());
+  }
+
+  bool operator!=(const TokenIterator& other) const {
+    return !(*this == other);
+  }
+
+ private:
+  WordScanner scanner_;
+  Token token_;
+  bool is_end_ = true;
+};
+
+class TokenRange {
+ public:
+  explicit TokenRange(const std::string_view text) : text_(text) {}
+
+  TokenIterator begin() const {
+    return TokenIterator(text_);
+  }
+
+  TokenIterator end() const {
+    return {};
+  }
+
+ private:
+  std::string_view text_;
+};
+
+// The space separated words of text, found lazily without building a container
+inline TokenRange SplitIntoTokens(const std::string_view text) {
+  return TokenRange(text);
+}
+
 std::vector<std::string_view> SplitIntoWords(const std::string_view & text);
 
 template<typename StringContainer>
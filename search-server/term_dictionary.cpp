@@ -0,0 +1,61 @@
+#include "term_dictionary.h"
+
+using namespace std;
+
+TermDictionary::TermDictionary() : slots_(16, EMPTY_SLOT) {}
+
+TermId TermDictionary::Find(string_view term) const {
+    const uint32_t slot = slots_[FindSlot(term, Hash(term))];
+    return slot == EMPTY_SLOT ? NO_TERM : slot - 1;
+}
+
+TermId TermDictionary::Insert(string_view term) {
+    const uint64_t hash = Hash(term);
+    size_t slot = FindSlot(term, hash);
+    if (slots_[slot] != EMPTY_SLOT) {
+        return slots_[slot] - 1;
+    }
+    // keep the load factor under 1/2 so probe sequences stay short
+    if ((terms_.size() + 1) * 2 > slots_.size()) {
+        Grow();
+        slot = FindSlot(term, hash);
+    }
+    const auto term_id = static_cast<TermId>(terms_.size());
+    terms_.emplace_back(term);
+    hashes_.push_back(hash);
+    slots_[slot] = term_id + 1;
+    return term_id;
+}
+
+uint64_t TermDictionary::Hash(string_view term) {
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ull;
+    for (const char c: term) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+size_t TermDictionary::FindSlot(string_view term, uint64_t hash) const {
+    const size_t mask = slots_.size() - 1;
+    for (size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+        const uint32_t entry = slots_[slot];
+        if (entry == EMPTY_SLOT || (hashes_[entry - 1] == hash && terms_[entry - 1] == term)) {
+            return slot;
+        }
+    }
+}
+
+void TermDictionary::Grow() {
+    vector<uint32_t> slots(slots_.size() * 2, EMPTY_SLOT);
+    const size_t mask = slots.size() - 1;
+    for (TermId term_id = 0; term_id < terms_.size(); ++term_id) {
+        size_t slot = hashes_[term_id] & mask;
+        while (slots[slot] != EMPTY_SLOT) {
+            slot = (slot + 1) & mask;
+        }
+        slots[slot] = term_id + 1;
+    }
+    slots_ = move(slots);
+}
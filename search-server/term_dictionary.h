@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using TermId = uint32_t;
+
+// Interns words into dense ids. Open addressing with linear probing; terms are never
+// removed, so an id and the view returned by GetTerm stay valid for the dictionary lifetime
+class TermDictionary {
+public:
+    static constexpr TermId NO_TERM = std::numeric_limits<TermId>::max();
+
+    TermDictionary();
+
+    TermId Find(std::string_view term) const;
+
+    TermId Insert(std::string_view term);
+
+    std::string_view GetTerm(TermId term_id) const {
+        return terms_[term_id];
+    }
+
+    std::size_t size() const {
+        return terms_.size();
+    }
+
+private:
+    static constexpr uint32_t EMPTY_SLOT = 0;
+
+    std::deque<std::string> terms_;
+    std::vector<uint64_t> hashes_;
+    // term id + 1, EMPTY_SLOT for a free slot
+    std::vector<uint32_t> slots_;
+
+    static uint64_t Hash(std::string_view term);
+
+    std::size_t FindSlot(std::string_view term, uint64_t hash) const;
+
+    void Grow();
+};
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "hash_mix.h"
+#include "term_dictionary.h"
+
+// 128-bit hash of a set of terms. Each term is mixed with two independent seeds and the
+// results are summed, so the fingerprint does not depend on the order of the terms
+struct TermSetFingerprint {
+    uint64_t low = 0;
+    uint64_t high = 0;
+
+    bool operator==(const TermSetFingerprint &other) const {
+        return low == other.low && high == other.high;
+    }
+
+    bool operator!=(const TermSetFingerprint &other) const {
+        return !(*this == other);
+    }
+};
+
+struct TermSetFingerprintHasher {
+    std::size_t operator()(const TermSetFingerprint &fingerprint) const {
+        return static_cast<std::size_t>(fingerprint.low);
+    }
+};
+
+inline uint64_t MixTermId(TermId term_id, uint64_t seed) {
+    return MixBits((term_id + seed) * 0x9e3779b97f4a7c15ULL);
+}
+
+// The terms must be distinct
+inline TermSetFingerprint ComputeTermSetFingerprint(const std::vector<TermId> &term_ids) {
+    TermSetFingerprint fingerprint;
+    for (const TermId term_id: term_ids) {
+        fingerprint.low += MixTermId(term_id, 0x243f6a8885a308d3ULL);
+        fingerprint.high += MixTermId(term_id, 0x13198a2e03707344ULL);
+    }
+    return fingerprint;
+}
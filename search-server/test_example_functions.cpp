@@ -0,0 +1,344 @@
+#include "test_example_functions.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <execution>
+#include <iostream>
+#include <new>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "search_server.h"
+
+using namespace std;
+
+namespace {
+
+atomic<size_t> allocation_count{0};
+
+// Unlike assert, also checks in release builds
+void Check(bool condition, const char *expression, const char *file, int line) {
+    if (!condition) {
+        cerr << file << "(" << line << "): check failed: " << expression << endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+}
+
+#define CHECK(expression) Check((expression), #expression, __FILE__, __LINE__)
+
+namespace {
+
+const int VOCABULARY_SIZE = 40;
+
+string MakeWord(int index) {
+    return "w"s + to_string(index);
+}
+
+// Skewed towards the first words, so their posting lists span several blocks
+string MakeText(mt19937 &generator, int word_count) {
+    string text;
+    for (int i = 0; i < word_count; ++i) {
+        const int index = static_cast<int>(generator() % VOCABULARY_SIZE * (generator() % VOCABULARY_SIZE))
+                          / VOCABULARY_SIZE;
+        text += MakeWord(index) + " "s;
+    }
+    return text;
+}
+
+// Every seventh document repeats the text before it with another rating, so there are ties in relevance
+void AddCorpus(SearchServer &search_server, mt19937 &generator, int first_id, int count) {
+    string text;
+    for (int id = first_id; id < first_id + count; ++id) {
+        if (id % 7 != 0 || text.empty()) {
+            text = MakeText(generator, 1 + static_cast<int>(generator() % 12));
+        }
+        search_server.AddDocument(id, text, static_cast<DocumentStatus>(generator() % 4),
+                                  {static_cast<int>(generator() % 10)});
+    }
+}
+
+// Plus and minus words, stop words and words missing from the index
+vector<string> MakeQueries(mt19937 &generator, int count) {
+    vector<string> queries;
+    for (int i = 0; i < count; ++i) {
+        string query;
+        const int word_count = 1 + static_cast<int>(generator() % 8);
+        for (int word = 0; word < word_count; ++word) {
+            switch (generator() % 8) {
+                case 0:
+                    query += "-"s + MakeWord(static_cast<int>(generator() % VOCABULARY_SIZE)) + " "s;
+                    break;
+                case 1:
+                    query += "and unknown "s;
+                    break;
+                default:
+                    query += MakeWord(static_cast<int>(generator() % VOCABULARY_SIZE)) + " "s;
+            }
+        }
+        queries.push_back(query);
+    }
+    return queries;
+}
+
+void CheckSameDocuments(const vector<Document> &expected, const vector<Document> &actual) {
+    CHECK(expected.size() == actual.size());
+    for (size_t i = 0; i < expected.size() && i < actual.size(); ++i) {
+        CHECK(expected[i].id == actual[i].id);
+        CHECK(abs(expected[i].relevance - actual[i].relevance) < 1e-9);
+        CHECK(expected[i].rating == actual[i].rating);
+    }
+}
+
+template<typename Function>
+bool ThrowsOutOfRange(Function function) {
+    try {
+        function();
+    } catch (const out_of_range &) {
+        return true;
+    }
+    return false;
+}
+
+// Same documents, iteration order, query results and matches; removed_ids are unknown to both
+void CheckSameSearchResults(SearchServer &expected, SearchServer &actual, const vector<string> &queries,
+                            const vector<int> &removed_ids) {
+    CHECK(expected.GetDocumentCount() == actual.GetDocumentCount());
+    const vector<int> document_ids(expected.begin(), expected.end());
+    CHECK(document_ids == vector<int>(actual.begin(), actual.end()));
+
+    const auto predicate = [](int document_id, DocumentStatus, int rating) {
+        return document_id % 2 == 0 || rating > 5;
+    };
+    for (const string &query: queries) {
+        CheckSameDocuments(expected.FindTopDocuments(query, DocumentStatus::ACTUAL, 20),
+                           actual.FindTopDocuments(query, DocumentStatus::ACTUAL, 20));
+        CheckSameDocuments(expected.FindTopDocuments(query, predicate, 20),
+                           actual.FindTopDocuments(query, predicate, 20));
+        CheckSameDocuments(expected.FindTopDocuments(execution::par, query, predicate, 20),
+                           actual.FindTopDocuments(execution::par, query, predicate, 20));
+        CHECK(expected.MatchDocuments(query, document_ids) == actual.MatchDocuments(query, document_ids));
+        for (const int document_id: removed_ids) {
+            CHECK(ThrowsOutOfRange([&] { actual.MatchDocument(query, document_id); }));
+            CHECK(ThrowsOutOfRange([&] { actual.MatchDocuments(query, {document_ids.front(), document_id}); }));
+        }
+    }
+}
+
+// Every query with each status and with a predicate, for several k and offsets
+template<typename ExecutionPolicy>
+void CheckMatchesExhaustive(SearchServer &search_server, QueryEvaluation query_evaluation, ExecutionPolicy policy,
+                            const vector<string> &queries) {
+    const auto predicate = [](int document_id, DocumentStatus status, int rating) {
+        return document_id % 3 != 0 && status != DocumentStatus::BANNED && rating > 2;
+    };
+    const pair<size_t, size_t> pages[] = {{1, 0}, {5, 0}, {5, 3}, {20, 0}, {3, 10}};
+    for (const string &query: queries) {
+        for (const auto &[k, offset]: pages) {
+            for (int status = 0; status < 4; ++status) {
+                search_server.SetQueryEvaluation(QueryEvaluation::EXHAUSTIVE);
+                const auto expected = search_server.FindTopDocuments(execution::seq, query,
+                                                                     static_cast<DocumentStatus>(status), k, offset);
+                search_server.SetQueryEvaluation(query_evaluation);
+                CheckSameDocuments(expected, search_server.FindTopDocuments(
+                        policy, query, static_cast<DocumentStatus>(status), k, offset));
+            }
+            search_server.SetQueryEvaluation(QueryEvaluation::EXHAUSTIVE);
+            const auto expected = search_server.FindTopDocuments(execution::seq, query, predicate, k, offset);
+            search_server.SetQueryEvaluation(query_evaluation);
+            CheckSameDocuments(expected, search_server.FindTopDocuments(policy, query, predicate, k, offset));
+        }
+    }
+}
+
+}
+
+void *operator new(size_t size) {
+    allocation_count.fetch_add(1, memory_order_relaxed);
+    if (void *pointer = malloc(size == 0 ? 1 : size)) {
+        return pointer;
+    }
+    throw bad_alloc();
+}
+
+void operator delete(void *pointer) noexcept {
+    free(pointer);
+}
+
+void operator delete(void *pointer, size_t) noexcept {
+    free(pointer);
+}
+
+void TestParseQueryWithoutAllocations() {
+    SearchServer search_server("and with"s);
+    search_server.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, {7, 2, 7});
+    search_server.AddDocument(2, "funny pet with curly hair"s, DocumentStatus::ACTUAL, {1, 2});
+    search_server.AddDocument(3, "big cat nasty hair"s, DocumentStatus::ACTUAL, {1, 2, 8});
+
+    // 31 words each: repeats, stop words and words missing from the index
+    const string plus_query = "curly and nasty funny pet with big cat hair hair unknown curly curly and nasty "
+                              "funny pet with big cat hair hair unknown curly nasty pet cat big with funny curly"s;
+    const string minus_query = "curly -rat and nasty funny pet with big cat hair hair -rat unknown -unknown "
+                               "curly curly -rat and nasty funny pet with big cat hair hair unknown -unknown "
+                               "curly big cat"s;
+    // what minus_query parses to
+    const string canonical_minus_query = "big cat curly funny hair nasty pet -rat"s;
+
+    const auto count_allocations = [](const auto &find_top_documents) {
+        find_top_documents();
+        const size_t allocations_before = allocation_count.load(memory_order_relaxed);
+        const auto documents = find_top_documents();
+        CHECK(!documents.empty());
+        return allocation_count.load(memory_order_relaxed) - allocations_before;
+    };
+
+    for (const auto query_evaluation: {QueryEvaluation::EXHAUSTIVE, QueryEvaluation::BLOCK_MAX}) {
+        search_server.SetQueryEvaluation(query_evaluation);
+
+        // a prepared query runs the same evaluation without parsing, so parsing allocates nothing. The
+        // predicate keeps the prepared query away from the result cache, which is off anyway
+        const auto prepared_query = search_server.PrepareQuery(plus_query);
+        CHECK(count_allocations([&] {
+            return search_server.FindTopDocuments(execution::seq, plus_query, DocumentStatus::ACTUAL);
+        }) == count_allocations([&] {
+            return search_server.FindTopDocuments(execution::seq, prepared_query,
+                                                  [](int, DocumentStatus status, int) {
+                                                      return status == DocumentStatus::ACTUAL;
+                                                  });
+        }));
+
+        // and neither do the words that minus words, repeats and unknown words add
+        CHECK(count_allocations([&] {
+            return search_server.FindTopDocuments(execution::seq, minus_query, DocumentStatus::ACTUAL);
+        }) == count_allocations([&] {
+            return search_server.FindTopDocuments(execution::seq, canonical_minus_query, DocumentStatus::ACTUAL);
+        }));
+    }
+}
+
+void TestBlockMaxMatchesExhaustive() {
+    mt19937 generator(7);
+    SearchServer search_server("and"s);
+    AddCorpus(search_server, generator, 0, 1500);
+    const auto queries = MakeQueries(generator, 40);
+
+    CheckMatchesExhaustive(search_server, QueryEvaluation::BLOCK_MAX, execution::seq, queries);
+    CheckMatchesExhaustive(search_server, QueryEvaluation::BLOCK_MAX, execution::par, queries);
+}
+
+void TestImpactOrderedMatchesExhaustive() {
+    mt19937 generator(13);
+    SearchServer search_server("and"s);
+    AddCorpus(search_server, generator, 0, 1500);
+    const auto queries = MakeQueries(generator, 40);
+
+    search_server.BuildImpactIndex();
+    CHECK(search_server.GetIndexStats().impact_bytes > 0);
+    CheckMatchesExhaustive(search_server, QueryEvaluation::IMPACT_ORDERED, execution::seq, queries);
+    CheckMatchesExhaustive(search_server, QueryEvaluation::IMPACT_ORDERED, execution::par, queries);
+
+    // without an impact index the evaluation falls back to BLOCK_MAX
+    AddCorpus(search_server, generator, 1500, 10);
+    CHECK(search_server.GetIndexStats().impact_bytes == 0);
+    CheckMatchesExhaustive(search_server, QueryEvaluation::IMPACT_ORDERED, execution::seq, queries);
+
+    search_server.BuildImpactIndex();
+    CHECK(search_server.GetIndexStats().impact_bytes > 0);
+    search_server.RemoveDocument(3);
+    CHECK(search_server.GetIndexStats().impact_bytes == 0);
+    CheckMatchesExhaustive(search_server, QueryEvaluation::IMPACT_ORDERED, execution::seq, queries);
+}
+
+void TestDeferredRemoval() {
+    mt19937 expected_generator(23);
+    mt19937 actual_generator(23);
+    SearchServer expected("and"s);
+    SearchServer actual("and"s);
+    AddCorpus(expected, expected_generator, 0, 400);
+    AddCorpus(actual, actual_generator, 0, 400);
+    actual.SetRemovalMode(RemovalMode::DEFERRED);
+    const auto queries = MakeQueries(expected_generator, 20);
+
+    vector<int> removed_ids;
+    for (int document_id = 0; document_id < 400; document_id += 5) {
+        removed_ids.push_back(document_id);
+        expected.RemoveDocument(document_id);
+        if (document_id % 2 == 0) {
+            actual.RemoveDocument(document_id);
+        } else {
+            actual.RemoveDocument(execution::par, document_id);
+        }
+    }
+    CHECK(actual.GetRemovedDocumentCount() == removed_ids.size());
+    CheckSameSearchResults(expected, actual, queries, removed_ids);
+
+    // a tombstoned id is free to be used again right away
+    expected.AddDocument(5, "w1 w2 w3"s, DocumentStatus::ACTUAL, {9});
+    actual.AddDocument(5, "w1 w2 w3"s, DocumentStatus::ACTUAL, {9});
+    removed_ids.erase(find(removed_ids.begin(), removed_ids.end(), 5));
+    CheckSameSearchResults(expected, actual, queries, removed_ids);
+
+    CHECK(actual.NeedsPurge());
+    actual.PurgeRemovedDocuments();
+    CHECK(actual.GetRemovedDocumentCount() == 0);
+    CHECK(!actual.NeedsPurge());
+    CheckSameSearchResults(expected, actual, queries, removed_ids);
+
+    expected.RemoveDocument(5);
+    actual.RemoveDocument(5);
+    expected.AddDocument(5, "w4 w5"s, DocumentStatus::BANNED, {1});
+    actual.AddDocument(5, "w4 w5"s, DocumentStatus::BANNED, {1});
+    CheckSameSearchResults(expected, actual, queries, removed_ids);
+}
+
+void TestDuplicateHandling() {
+    SearchServer search_server("and in"s);
+    CHECK(!search_server.AddDocument(1, "cat in the hat"s, DocumentStatus::ACTUAL, {1}));
+    CHECK(!search_server.AddDocument(2, "hat the cat"s, DocumentStatus::ACTUAL, {1}));
+
+    // turning the check on picks up the documents indexed so far; order, repeats and stop words don't matter
+    search_server.SetDuplicateHandling(DuplicateHandling::REPORT);
+    CHECK(search_server.AddDocument(3, "the hat and the cat"s, DocumentStatus::BANNED, {2}) == 1);
+    CHECK(search_server.GetDocumentCount() == 3);
+    CHECK(!search_server.AddDocument(4, "the hat and the dog"s, DocumentStatus::ACTUAL, {2}));
+
+    search_server.SetDuplicateHandling(DuplicateHandling::REJECT);
+    const auto original_id = search_server.AddDocument(5, "dog the hat"s, DocumentStatus::ACTUAL, {3});
+    CHECK(original_id == 4);
+    CHECK(search_server.GetDocumentCount() == 4);
+    CHECK(search_server.GetDocumentText(5).empty());
+    CHECK(!search_server.AddDocument(5, "dog"s, DocumentStatus::ACTUAL, {3}));
+
+    // a removed document is no original
+    search_server.RemoveDocument(4);
+    CHECK(!search_server.AddDocument(6, "dog hat the"s, DocumentStatus::ACTUAL, {3}));
+    search_server.SetRemovalMode(RemovalMode::DEFERRED);
+    search_server.RemoveDocument(6);
+    CHECK(!search_server.AddDocument(7, "the hat dog"s, DocumentStatus::ACTUAL, {3}));
+    CHECK(search_server.AddDocument(8, "the hat dog"s, DocumentStatus::ACTUAL, {3}) == 7);
+
+    // once cat, hat and the are gone from every indexed document, a fourth copy is new
+    for (const int document_id: {1, 2, 3}) {
+        search_server.RemoveDocument(document_id);
+    }
+    search_server.PurgeRemovedDocuments();
+    CHECK(!search_server.AddDocument(9, "cat the hat"s, DocumentStatus::ACTUAL, {1}));
+
+    search_server.SetDuplicateHandling(DuplicateHandling::ALLOW);
+    CHECK(!search_server.AddDocument(10, "cat the hat"s, DocumentStatus::ACTUAL, {1}));
+    CHECK(search_server.GetDocumentCount() == 4);
+}
+
+void TestSearchServer() {
+    TestParseQueryWithoutAllocations();
+    TestBlockMaxMatchesExhaustive();
+    TestImpactOrderedMatchesExhaustive();
+    TestDeferredRemoval();
+    TestDuplicateHandling();
+    cout << "Search server tests passed" << endl;
+}
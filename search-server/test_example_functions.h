@@ -0,0 +1,20 @@
+#pragma once
+
+// Checks that parsing a query of fewer than 32 words adds no heap allocation to FindTopDocuments.
+// test_example_functions.cpp replaces the global operator new to count them
+void TestParseQueryWithoutAllocations();
+
+// BLOCK_MAX, sequential and partitioned, returns what EXHAUSTIVE does
+void TestBlockMaxMatchesExhaustive();
+
+// IMPACT_ORDERED returns what EXHAUSTIVE does, also once a change has dropped the impact index
+void TestImpactOrderedMatchesExhaustive();
+
+// A DEFERRED removal hides the document at once and gives the results of IMMEDIATE removal, before
+// and after PurgeRemovedDocuments; a removed id can be added again
+void TestDeferredRemoval();
+
+// REPORT and REJECT find documents with the same set of words, but not removed ones
+void TestDuplicateHandling();
+
+void TestSearchServer();
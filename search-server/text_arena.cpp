@@ -0,0 +1,105 @@
+#include "text_arena.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+TextArena::TextArena(size_t chunk_size) : chunk_size_(chunk_size) {}
+
+TextSpan TextArena::Store(string_view text) {
+    if (text.empty()) {
+        return {NO_CHUNK, 0, 0};
+    }
+    uint32_t chunk = active_chunk_;
+    if (text.size() > chunk_size_ / 4) {
+        // large texts get a chunk of their own instead of wasting the tail of the active one
+        chunk = OpenChunk(text.size());
+    } else if (chunk == NO_CHUNK || chunks_[chunk].capacity - chunks_[chunk].used < text.size()) {
+        chunk = OpenChunk(chunk_size_);
+        active_chunk_ = chunk;
+    }
+
+    auto &target = chunks_[chunk];
+    const auto offset = static_cast<uint32_t>(target.used);
+    memcpy(target.data.get() + offset, text.data(), text.size());
+    target.used += text.size();
+    target.live += text.size();
+    live_bytes_ += text.size();
+    return {chunk, offset, static_cast<uint32_t>(text.size())};
+}
+
+string_view TextArena::Get(TextSpan span) const {
+    if (span.chunk == NO_CHUNK) {
+        return {};
+    }
+    return {chunks_[span.chunk].data.get() + span.offset, span.size};
+}
+
+void TextArena::Release(TextSpan span) {
+    if (span.chunk == NO_CHUNK) {
+        return;
+    }
+    auto &chunk = chunks_[span.chunk];
+    chunk.live -= span.size;
+    live_bytes_ -= span.size;
+    if (chunk.live == 0 && span.chunk != active_chunk_) {
+        FreeChunk(span.chunk);
+    }
+}
+
+bool TextArena::NeedsCompaction() const {
+    return allocated_bytes_ > 2 * chunk_size_ && live_bytes_ * 2 < allocated_bytes_;
+}
+
+void TextArena::Compact(vector<TextSpan> &spans) {
+    vector<bool> evacuate(chunks_.size(), false);
+    for (uint32_t chunk = 0; chunk < chunks_.size(); ++chunk) {
+        evacuate[chunk] = chunks_[chunk].data && chunks_[chunk].live * 2 < chunks_[chunk].capacity;
+    }
+    if (active_chunk_ != NO_CHUNK && evacuate[active_chunk_]) {
+        // start filling a fresh chunk so the copies never land in a chunk being evacuated
+        active_chunk_ = NO_CHUNK;
+    }
+
+    // the evacuated chunks stay readable until every span has been copied out
+    for (auto &span: spans) {
+        if (span.chunk != NO_CHUNK && evacuate[span.chunk]) {
+            const string_view text = Get(span);
+            chunks_[span.chunk].live -= span.size;
+            live_bytes_ -= span.size;
+            span = Store(text);
+        }
+    }
+    for (uint32_t chunk = 0; chunk < evacuate.size(); ++chunk) {
+        if (evacuate[chunk]) {
+            FreeChunk(chunk);
+        }
+    }
+}
+
+uint32_t TextArena::OpenChunk(size_t capacity) {
+    uint32_t chunk;
+    if (free_chunks_.empty()) {
+        chunk = static_cast<uint32_t>(chunks_.size());
+        chunks_.emplace_back();
+    } else {
+        chunk = free_chunks_.back();
+        free_chunks_.pop_back();
+    }
+    chunks_[chunk].data = make_unique<char[]>(capacity);
+    chunks_[chunk].capacity = capacity;
+    chunks_[chunk].used = 0;
+    chunks_[chunk].live = 0;
+    allocated_bytes_ += capacity;
+    return chunk;
+}
+
+void TextArena::FreeChunk(uint32_t chunk) {
+    allocated_bytes_ -= chunks_[chunk].capacity;
+    chunks_[chunk] = Chunk{};
+    free_chunks_.push_back(chunk);
+    if (chunk == active_chunk_) {
+        active_chunk_ = NO_CHUNK;
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+// Location of a text inside a TextArena; changes when the arena is compacted
+struct TextSpan {
+    uint32_t chunk;
+    uint32_t offset;
+    uint32_t size;
+};
+
+// Bump allocator for document texts. Released bytes are counted per chunk; a chunk with
+// no live texts is freed, and Compact moves the texts out of sparsely used chunks
+class TextArena {
+public:
+    static constexpr uint32_t NO_CHUNK = std::numeric_limits<uint32_t>::max();
+    static constexpr std::size_t DEFAULT_CHUNK_SIZE = 1 << 16;
+
+    explicit TextArena(std::size_t chunk_size = DEFAULT_CHUNK_SIZE);
+
+    TextSpan Store(std::string_view text);
+
+    std::string_view Get(TextSpan span) const;
+
+    void Release(TextSpan span);
+
+    // True once less than half of the allocated bytes are in use
+    bool NeedsCompaction() const;
+
+    // spans must hold every live span of the arena; they are updated in place.
+    // Released spans (chunk == NO_CHUNK) are skipped
+    void Compact(std::vector<TextSpan> &spans);
+
+    std::size_t GetAllocatedBytes() const {
+        return allocated_bytes_;
+    }
+
+    std::size_t GetLiveBytes() const {
+        return live_bytes_;
+    }
+
+private:
+    struct Chunk {
+        std::unique_ptr<char[]> data;
+        std::size_t capacity = 0;
+        std::size_t used = 0;
+        std::size_t live = 0;
+    };
+
+    std::size_t chunk_size_;
+    std::vector<Chunk> chunks_;
+    std::vector<uint32_t> free_chunks_;
+    uint32_t active_chunk_ = NO_CHUNK;
+    std::size_t allocated_bytes_ = 0;
+    std::size_t live_bytes_ = 0;
+
+    uint32_t OpenChunk(std::size_t capacity);
+
+    void FreeChunk(uint32_t chunk);
+};
@@ -0,0 +1,43 @@
+#include "top_documents.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+bool IsRankedHigher(const Document &lhs, const Document &rhs) {
+    if (abs(lhs.relevance - rhs.relevance) >= EPSILON) {
+        return lhs.relevance > rhs.relevance;
+    }
+    if (lhs.rating != rhs.rating) {
+        return lhs.rating > rhs.rating;
+    }
+    return lhs.id < rhs.id;
+}
+
+TopDocuments::TopDocuments(size_t count) : count_(count) {
+}
+
+bool TopDocuments::CanEnter(double relevance_bound) const {
+    if (heap_.size() < count_) {
+        return true;
+    }
+    // the bound is a sum computed in a different order than the score, so allow for rounding too
+    return count_ > 0 && relevance_bound > heap_.front().relevance - 2 * EPSILON;
+}
+
+void TopDocuments::Add(const Document &document) {
+    if (heap_.size() < count_) {
+        heap_.push_back(document);
+        push_heap(heap_.begin(), heap_.end(), IsRankedHigher);
+    } else if (count_ > 0 && IsRankedHigher(document, heap_.front())) {
+        pop_heap(heap_.begin(), heap_.end(), IsRankedHigher);
+        heap_.back() = document;
+        push_heap(heap_.begin(), heap_.end(), IsRankedHigher);
+    }
+}
+
+vector<Document> TopDocuments::Extract() {
+    sort_heap(heap_.begin(), heap_.end(), IsRankedHigher);
+    return move(heap_);
+}
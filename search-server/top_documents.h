@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "document.h"
+
+const auto EPSILON = 1e-6;
+
+// Relevance first (values closer than EPSILON are equal), then rating; the id breaks
+// the remaining ties so every evaluation strategy ranks documents the same way
+bool IsRankedHigher(const Document &lhs, const Document &rhs);
+
+// Keeps the best `count` documents seen so far
+class TopDocuments {
+public:
+    explicit TopDocuments(std::size_t count);
+
+    // False once no document with relevance up to relevance_bound can get in. A document
+    // within EPSILON of the current last one may still win on rating, hence the margin
+    bool CanEnter(double relevance_bound) const;
+
+    void Add(const Document &document);
+
+    // Best first
+    std::vector<Document> Extract();
+
+private:
+    std::size_t count_;
+    // Heap with the lowest ranked document on top
+    std::vector<Document> heap_;
+};